@@ -1,54 +1,373 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
+#include <stdarg.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Initial capacity of the simulator tables; each table doubles when it fills up
+#define DEFAULT_CAPACITY 50
+
+// Maximum number of size classes for the segregated-fit strategy (one bitmap word)
+#define MAX_SIZE_CLASSES 64
+
+// Largest block order of the buddy allocator (blocks of 2^order KB)
+#define BUDDY_MAX_ORDER 30
+
+// First-fit lookup selected by --index
+#define INDEX_LINEAR 0
+#define INDEX_TREE 1
+#define INDEX_SIMD 2
+
+// Times the bypass wait policy lets later waiters pass the oldest one by default
+#define DEFAULT_MAX_BYPASS 8
+
+// Hot-path instrumentation: build with -DFF_STATS to count work on the allocate, free and
+// wait-queue paths and time each operation; without it the counters compile to nothing
+#ifdef FF_STATS
+#define STAT_INC(counter) ((counter)++)
+#define STAT_ADD(counter, amount) ((counter) += (amount))
+#define STAT_TIMER_START(name) double name = monotonic_ns()
+#define STAT_TIMER_STOP(histogram, name) histogram_record(&(histogram), (long)(monotonic_ns() - (name)))
+#else
+#define STAT_INC(counter) ((void)0)
+#define STAT_ADD(counter, amount) ((void)0)
+#define STAT_TIMER_START(name) ((void)0)
+#define STAT_TIMER_STOP(histogram, name) ((void)0)
+#endif
+
+// Interactive layout view: largest free blocks and allocated/free runs in the summary,
+// and rows per page of the full dump
+#define LAYOUT_TOP_FREE 5
+#define LAYOUT_MAP_RUNS 16
+#define LAYOUT_PAGE_ROWS 40
+
+// Benchmark suite: rounds of the round-based scenarios, fragmentation sampling interval
+// (in allocations) and the size of each of the four initial blocks in KB
+#define BENCH_ROUNDS 20
+#define BENCH_SAMPLE_INTERVAL 1024
+#define BENCH_BLOCK_SIZE 262144
+
+// Thread caches of the concurrent mode: power-of-two size classes from 1KB up to
+// 2^(THREAD_CACHE_CLASSES - 1) KB, each holding up to THREAD_CACHE_DEPTH freed blocks
+#define THREAD_CACHE_CLASSES 7
+#define THREAD_CACHE_DEPTH 16
+
+// Most threads the concurrent mode will start
+#define MAX_CONCURRENT_THREADS 1024
+
+// Telemetry: events between two publishes of a simulation's values, and the default
+// reporting interval in milliseconds
+#define TELEMETRY_PUBLISH_EVENTS 4096
+#define TELEMETRY_INTERVAL_MS 1000
+
+// Binary trace file signature, format version and record flags
+#define TRACE_MAGIC "FFTRACE"
+#define TRACE_VERSION 2
+#define TRACE_TIMED 0x01
+
+// Binary metrics file signature and format version
+#define METRICS_MAGIC "FFMETRC"
+#define METRICS_VERSION 2
+
+// Memory system snapshot file signature, format version and number of table sections
+#define SNAPSHOT_MAGIC "FFSNAPS"
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_TABLES 12
+
+// Engine bodies are inlined into every specialized variant, where their strategy and
+// coalescing policy are constants
+#define ENGINE_INLINE static inline __attribute__((always_inline))
 
-// Maximum limits for simulation system
-#define MAX_BLOCKS 50      // Maximum number of memory blocks that can be managed
-#define MAX_PROCESSES 50   // Maximum number of concurrent processes supported
-#define MAX_WAIT_QUEUE 50  // Maximum number of processes that can wait for memory
+// Width of memory addresses and sizes (in KB): 64-bit by default for large heaps, or the
+// compact 32-bit layout with -DFF_ADDR32 for cache-sensitive runs
+#ifdef FF_ADDR32
+typedef int32_t kb_t;
+#define KB_MAX INT32_MAX
+#define PRIkb PRId32
+#else
+typedef int64_t kb_t;
+#define KB_MAX INT64_MAX
+#define PRIkb PRId64
+#endif
 
 // Represents a single memory block in the system
+// Blocks live in a pool and are chained in address order, so split and merge are O(1)
 typedef struct {
-    int start;     // Starting memory address of the block
-    int size;      // Size of the memory block in kilobytes
+    kb_t start;    // Starting memory address of the block
+    kb_t size;     // Size of the memory block in kilobytes
     int is_free;   // Flag indicating whether the block is available (1) or allocated (0)
+    int prev;      // Pool index of the previous block in address order (-1 if first)
+    int next;      // Pool index of the next block in address order (-1 if last)
+    int free_prev; // Previous block in the strategy's free list (size-class bin), -1 if first
+    int free_next; // Next block in the strategy's free list (size-class bin), -1 if last
 } MemoryBlock;
 
 // Represents a process with its memory allocation details
 typedef struct {
     int id;                // Unique identifier for the process
-    int memory_address;    // Starting memory address allocated to the process
-    int memory_size;       // Amount of memory allocated to the process
+    kb_t memory_address;   // Starting memory address allocated to the process
+    kb_t memory_size;      // Amount of memory allocated to the process
     int is_active;         // Flag indicating if the process is currently running
+    int block;             // Pool index of the process's block; links recycled slots when inactive
+    long departs_at;       // Simulated time of its scheduled departure (0: runs until freed)
 } Process;
 
 // Represents a process waiting for memory allocation
+// Waiters live in a pool chained in arrival order, so any of them can leave in O(1)
 typedef struct {
     int process_id;        // ID of the process waiting for memory
-    int memory_size;       // Amount of memory the process needs
+    kb_t memory_size;      // Amount of memory the process needs
+    kb_t block_size;       // Block size the placement strategy carves for the request
+    int seq;               // Arrival number, the waiter's key in the wait index
+    int bypassed;          // Times later waiters were served first while it was at the head
+    long enqueued_at;      // Logical time at which the process started waiting
+    long duration;         // Simulated time the process runs once placed (0: until freed)
+    int prev;              // Pool index of the previous waiter in arrival order (-1 if first)
+    int next;              // Pool index of the next waiter (-1 if last); links recycled slots
 } WaitingProcess;
 
-// Comprehensive system memory management structure
+// Departure scheduled by the discrete-event engine: at `time` the process ends and its memory
+// is freed, unless it was freed by hand in the meantime
+typedef struct {
+    long time;             // Simulated time of the departure
+    int process_id;        // Process that departs
+} Departure;
+
+// Node of the free-block index: a treap keyed by start address (or by size, then address)
+// whose nodes also carry the largest free block size found anywhere in their subtree
+typedef struct {
+    kb_t start;             // Starting address of the free block
+    kb_t size;              // Size of the free block
+    int block;              // Pool index of the free block in SystemMemory.blocks
+    kb_t max_size;          // Largest block size in this node's subtree
+    unsigned int priority;  // Random heap priority that keeps the treap balanced
+    int left;               // Node index of the left child (-1 if none)
+    int right;              // Node index of the right child (-1 if none)
+} FreeIndexNode;
+
+// Ordered index of free blocks answering fit queries in O(log n)
+typedef struct {
+    FreeIndexNode *nodes;   // Node pool; unused nodes are chained through `left`
+    int by_size;            // Order by (size, start) instead of by start address
+    int capacity;           // Allocated length of nodes
+    int used;               // Number of pool slots handed out so far
+    int free_list;          // Head of the recycled node chain (-1 if empty)
+    int root;               // Node index of the treap root (-1 if empty)
+    unsigned int seed;      // State of the priority generator
+#ifdef FF_STATS
+    long visits;            // Nodes examined by fit queries
+#endif
+} FreeIndex;
+
+// Free blocks in address order as parallel arrays, so a first-fit scan reads only sizes
+typedef struct {
+    kb_t *sizes;            // Sizes of the free blocks, lowest address first
+    kb_t *starts;           // Their start addresses, searched when blocks come and go
+    int *blocks;            // Their pool indices in SystemMemory.blocks
+    int count;              // Number of free blocks held
+    int capacity;           // Allocated length of each array
+} FreeArray;
+
+// Slot of the process map: an open-addressing hash table from process id to process slot
+typedef struct {
+    int id;                // Process id stored in this slot (0 marks an empty slot)
+    int slot;              // Index of the process record in SystemMemory.processes
+} ProcessMapEntry;
+
+// Linear-probing hash map from process id to its record, kept at most half full
+typedef struct {
+    ProcessMapEntry *entries;  // Table of 2^k entries
+    int capacity;              // Number of entries (a power of two, or 0 before first use)
+    int count;                 // Number of occupied entries
+} ProcessMap;
+
+// When adjacent free blocks are merged back together
+typedef enum {
+    COALESCE_IMMEDIATE,   // Merge with both neighbours as soon as a block is freed
+    COALESCE_DEFERRED,    // Merge all free runs in one pass when an allocation finds no fit
+    COALESCE_NEVER        // Never merge; freed blocks keep their split boundaries
+} CoalescePolicy;
+
+// Which waiting process is served when memory is released
+typedef enum {
+    WAIT_FIFO,        // Only the oldest waiter, once total free memory covers its request
+    WAIT_FIRST_FIT,   // The oldest waiter whose block fits in the largest free block
+    WAIT_SMALLEST,    // The waiter with the smallest block, once it fits
+    WAIT_BYPASS       // The oldest waiter; fitting waiters may pass it a bounded number of times
+} WaitPolicy;
+
+// Log-linear histogram: 2^HISTOGRAM_SUB_BITS buckets below 2^HISTOGRAM_SUB_BITS, then half
+// as many linear sub-buckets per power of two, so every value keeps about 6% precision
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BITS) * (HISTOGRAM_SUB_BUCKETS / 2) + HISTOGRAM_SUB_BUCKETS)
+
+// Distribution of non-negative values such as wait times
 typedef struct {
-    MemoryBlock blocks[MAX_BLOCKS];         // Array of memory blocks
-    Process processes[MAX_PROCESSES];        // Array of active processes
-    WaitingProcess wait_queue[MAX_WAIT_QUEUE]; // Queue for processes waiting for memory
+    long counts[HISTOGRAM_BUCKETS]; // Number of values recorded in each bucket
+    long total;                     // Number of values recorded
+    long max;                       // Largest value recorded
+} Histogram;
+
+#ifdef FF_STATS
+// Work counters and latency histograms of the hot paths (FF_STATS builds only)
+typedef struct {
+    long blocks_scanned;            // Blocks examined by linear scans and free-list walks
+    long splits;                    // Blocks split to carve an allocation
+    long enqueues;                  // Processes added to the wait queue
+    long dequeues;                  // Processes removed from the wait queue (served or withdrawn)
+    long drains;                    // Wait-queue drains run
+    long drain_iterations;          // Loop iterations across all drains
+    Histogram scan_lengths;         // Blocks and index nodes examined per placement attempt
+    Histogram allocate_ns;          // Latency of allocate_memory() in nanoseconds
+    Histogram free_ns;              // Latency of free_memory(), including its drain
+    Histogram drain_ns;             // Latency of drain_wait_queue()
+} HotPathStats;
+#endif
+
+struct SystemMemory;
+
+// Placement strategy: decides which free block serves a request and keeps its own index
+// of free blocks in sync as blocks are freed, split, merged and allocated
+typedef struct {
+    const char *name;                                        // Name used on the command line
+    int free_index_by_size;                                  // Order of free_index (-1 if unused)
+    kb_t (*block_size)(struct SystemMemory *sys, kb_t size); // Block size carved for a request (NULL: exact)
+    int (*find_block)(struct SystemMemory *sys, kb_t size);  // Pick a free block, or -1 if none fits
+    void (*add_free)(struct SystemMemory *sys, int block);  // Index a newly free block (NULL: no index)
+    void (*remove_free)(struct SystemMemory *sys, int block); // Drop a free block from the index
+    void (*clear_free)(struct SystemMemory *sys);            // Empty the index at once (NULL: block by block)
+    void (*on_allocate)(struct SystemMemory *sys, int block, kb_t size); // Called after placement
+    void (*carve)(struct SystemMemory *sys, int block, kb_t size); // Cut a chosen block down (NULL: one split)
+    int (*coalesce)(struct SystemMemory *sys, int block);   // Merge a freed block (NULL: neighbour merge)
+    int (*prepare)(struct SystemMemory *sys);                // Lay out the initial blocks (NULL: as given)
+} PlacementStrategy;
+
+// Allocate and free entry points of the engine, either specialized at compile time for one
+// strategy and coalescing policy or generic over both
+typedef struct {
+    const char *name;                                                 // Name in summaries
+    const PlacementStrategy *strategy;                                // Strategy built in (NULL: generic)
+    CoalescePolicy coalesce;                                          // Coalescing policy built in
+    kb_t (*place)(struct SystemMemory *sys, int process_id, kb_t size); // place_process() body
+    int (*release)(struct SystemMemory *sys, int process_id);        // release_process() body
+} EngineVariant;
+
+// Startup options for a memory system
+typedef struct {
+    int capacity;                         // Initial length of each table; tables grow on demand past it
+    const PlacementStrategy *strategy;    // Placement strategy and its free-block index
+    CoalescePolicy coalesce;              // When adjacent free blocks are merged
+    const kb_t *size_classes;             // Ascending size-class bounds for segregated fit (NULL: 2^k)
+    int num_size_classes;                 // Number of entries in size_classes
+    WaitPolicy wait_policy;               // Which waiting process is served when memory is freed
+    int max_bypass;                       // Bypass policy: times the oldest waiter may be passed
+    int compact_on_stall;                 // Compact when the wait queue stalls on fragmentation
+} MemoryConfig;
+
+// Comprehensive system memory management structure
+typedef struct SystemMemory {
+    MemoryBlock *blocks;                    // Pool of memory blocks linked in address order
+    Process *processes;                     // Pool of process records, slots recycled on free
+    WaitingProcess *wait_queue;             // Pool of waiting processes chained in arrival order
+    int blocks_capacity;                    // Allocated length of blocks
+    int blocks_used;                        // Number of block pool slots handed out so far
+    int free_block_slot;                    // Head of the recycled block slot chain (-1 if empty)
+    int first_block;                        // Pool index of the lowest-address block
+    int processes_capacity;                 // Allocated length of processes
+    int processes_used;                     // Number of process slots handed out so far
+    int free_process_slot;                  // Head of the recycled process slot chain (-1 if empty)
+    ProcessMap process_map;                 // Process id -> process slot lookup
+    ProcessMap wait_map;                    // Process id -> wait queue slot of waiting processes
+    int wait_queue_capacity;                // Allocated length of wait_queue
+    int wait_queue_used;                    // Number of wait queue slots handed out so far
+    int free_wait_slot;                     // Head of the recycled wait queue slot chain (-1 if empty)
     int num_blocks;                         // Current number of memory blocks
+    int peak_blocks;                        // Highest number of memory blocks seen
     int num_processes;                      // Current number of active processes
     int wait_queue_count;                   // Number of processes in waiting queue
-    int wait_queue_front;                   // Index of the front of the waiting queue
-    int wait_queue_rear;                    // Index of the rear of the waiting queue
+    int wait_queue_front;                   // Pool index of the oldest waiter (-1 if none)
+    int wait_queue_rear;                    // Pool index of the newest waiter (-1 if none)
+    int wait_seq;                           // Arrival number handed to the next waiter
+    WaitPolicy wait_policy;                 // Which waiting process is served when memory is freed
+    int max_bypass;                         // Bypass policy: times the oldest waiter may be passed
+    FreeIndex wait_index;                   // Waiters by arrival (or by block size) with fit queries
+    long bypasses;                          // Waiters served ahead of an older, blocked waiter
+    long withdrawn;                         // Waiters removed by a free before being served
+    long clock;                             // Logical time, advanced once per simulated event
+    Histogram wait_times;                   // Time each served waiter spent in the queue
+    Departure *departures;                  // Min-heap of scheduled departures by time
+    int departures_capacity;                // Allocated length of departures
+    int departure_count;                    // Number of scheduled departures
+    int departures_peak;                    // Highest number of departures scheduled at once
+    long departed;                          // Processes freed by their departure
+    int verbose;                            // Print per-operation messages (0 in batch mode)
+    const PlacementStrategy *strategy;      // Placement strategy in use
+    const EngineVariant *engine;            // Allocate and free entry points for strategy and coalesce
+    int use_index;                          // Strategy keeps free blocks in free_index
+    FreeIndex free_index;                   // Ordered max-size index of free blocks
+    FreeArray free_array;                   // SIMD first fit: free block sizes in address order
+    kb_t rover;                             // Next-fit roving pointer: address to resume searching from
+    kb_t class_bounds[MAX_SIZE_CLASSES];    // Segregated fit: lower size bound of each class, ascending
+    int num_classes;                        // Segregated fit: number of size classes
+    int bin_heads[MAX_SIZE_CLASSES];        // Segregated fit: head block of each class's free list
+    unsigned long long bin_bitmap;          // Segregated fit: bit k set while bin k is non-empty
+    unsigned char *buddy_bits;              // Buddy: per-order bitmaps, bit set while that block is free
+    long buddy_offset[BUDDY_MAX_ORDER + 1]; // Buddy: first bit of each order's bitmap
+    CoalescePolicy coalesce;                // When adjacent free blocks are merged
+    int pending_coalesce;                   // Frees not yet merged under deferred coalescing
+    int in_batch;                           // Frees leave the wait queue to end_batch()
+    int drain_pending;                      // The current batch released memory for waiters
+    long merges;                            // Number of neighbour merges performed
+    long coalesce_passes;                   // Number of deferred coalescing passes run
+    kb_t total_memory;                      // Size of all memory blocks together in KB
+    kb_t free_total;                        // Running total of free memory in KB
+    int free_block_count;                   // Running number of free blocks
+    kb_t largest_free;                      // Largest free block size (valid unless largest_stale)
+    int largest_stale;                      // Set when the largest free block left the linear mode cache
+    long internal_fragmentation;            // KB allocated beyond what live processes requested
+    int compact_on_stall;                   // Compact when the wait queue stalls on fragmentation
+    long compactions;                       // Number of compaction passes run
+    long compaction_moved;                  // KB of allocated blocks moved by compaction
+    double compaction_seconds;              // Wall-clock time spent compacting
+    long compaction_served;                 // Waiters served by drains that compacted memory
+#ifdef FF_STATS
+    HotPathStats stats;                     // Hot-path counters and latency histograms
+#endif
 } SystemMemory;
 
 // Function prototypes to resolve circular dependencies
-int first_fit_allocate(SystemMemory *sys, int process_id, int size);
-int add_to_wait_queue(SystemMemory *sys, int process_id, int size);
-int get_total_free_memory(SystemMemory *sys);
+kb_t place_process(SystemMemory *sys, int process_id, kb_t size);
+int add_to_wait_queue(SystemMemory *sys, int process_id, kb_t size);
+int free_memory(SystemMemory *sys, int process_id);
+kb_t get_total_free_memory(SystemMemory *sys);
+const EngineVariant *select_engine(const PlacementStrategy *strategy, CoalescePolicy coalesce);
 
 // Input validation helper function
-int get_valid_integer(const char *prompt, int min, int max) {
-    int value;
+long long get_valid_integer(const char *prompt, long long min, long long max) {
+    long long value;
     char buffer[100];
 
     while (1) {
@@ -63,9 +382,9 @@ int get_valid_integer(const char *prompt, int min, int max) {
 
         // Check if input is a number
         char *endptr;
-        value = strtol(buffer, &endptr, 10);
+        value = strtoll(buffer, &endptr, 10);
         if (*endptr != '\0' || value < min || value > max) {
-            printf("Invalid input. Please enter an integer between %d and %d.\n", min, max);
+            printf("Invalid input. Please enter an integer between %lld and %lld.\n", min, max);
         } else {
             break;
         }
@@ -74,264 +393,5455 @@ int get_valid_integer(const char *prompt, int min, int max) {
     return value;
 }
 
-// Initialize the memory system with predefined memory blocks
-void initialize_memory(SystemMemory *sys, int num_blocks, int block_sizes[]) {
-    // Reset the entire system memory structure to zero
-    memset(sys, 0, sizeof(SystemMemory));
+// Grow a heap-backed table geometrically so that it holds at least `needed` elements
+// Returns 0 on success, -1 if the table could not be grown
+int ensure_capacity(void **array, int *capacity, int needed, size_t element_size) {
+    if (needed <= *capacity) {
+        return 0;
+    }
 
-    // Assign memory blocks with sequential starting addresses
-    int start_address = 0;
-    for (int i = 0; i < num_blocks; i++) {
-        sys->blocks[i].start = start_address;      // Set starting address
-        sys->blocks[i].size = block_sizes[i];      // Set block size
-        sys->blocks[i].is_free = 1;                // Mark block as free initially
-        start_address += block_sizes[i];           // Update start address for next block
+    // Double the capacity until the request fits, guarding against int overflow
+    long new_capacity = *capacity > 0 ? *capacity : DEFAULT_CAPACITY;
+    while (new_capacity < needed) {
+        new_capacity *= 2;
+    }
+    if (new_capacity > INT_MAX) {
+        new_capacity = INT_MAX;
     }
 
-    // Set initial system memory parameters
-    sys->num_blocks = num_blocks;
-    sys->wait_queue_front = 0;
-    sys->wait_queue_rear = -1;
-    sys->wait_queue_count = 0;
+    void *grown = realloc(*array, (size_t)new_capacity * element_size);
+    if (grown == NULL) {
+        return -1;
+    }
+    *array = grown;
+    *capacity = (int)new_capacity;
+    return 0;
+}
+
+// Monotonic clock reading in nanoseconds
+static inline double monotonic_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec * 1e9 + (double)now.tv_nsec;
+}
+
+// Bucket holding a value: values below HISTOGRAM_SUB_BUCKETS get a bucket each, larger
+// ones keep their top HISTOGRAM_SUB_BITS bits
+static inline int histogram_bucket(long value) {
+    unsigned long long v = value > 0 ? (unsigned long long)value : 0;
+    int shift = 0;
+    if (v >= HISTOGRAM_SUB_BUCKETS) {
+        shift = 63 - __builtin_clzll(v) - (HISTOGRAM_SUB_BITS - 1);
+    }
+    return shift * (HISTOGRAM_SUB_BUCKETS / 2) + (int)(v >> shift);
+}
+
+// Largest value that falls into a bucket
+static inline long histogram_bucket_high(int bucket) {
+    int shift = bucket < HISTOGRAM_SUB_BUCKETS ? 0 :
+                (bucket - HISTOGRAM_SUB_BUCKETS) / (HISTOGRAM_SUB_BUCKETS / 2) + 1;
+    unsigned long long top = (unsigned long long)(bucket - shift * (HISTOGRAM_SUB_BUCKETS / 2));
+    return (long)(((top + 1) << shift) - 1);
+}
+
+// Record one value in a histogram
+void histogram_record(Histogram *histogram, long value) {
+    histogram->counts[histogram_bucket(value)]++;
+    histogram->total++;
+    if (value > histogram->max) {
+        histogram->max = value;
+    }
 }
 
-// Calculate the total amount of free memory in the system
-int get_total_free_memory(SystemMemory *sys) {
-    int total_free = 0;
-    // Sum up sizes of all free memory blocks
-    for (int i = 0; i < sys->num_blocks; i++) {
-        if (sys->blocks[i].is_free) {
-            total_free += sys->blocks[i].size;
+// Value at or below which `percent` percent of the recorded values fall (0 if empty)
+long histogram_percentile(const Histogram *histogram, double percent) {
+    long rank = (long)(percent / 100.0 * histogram->total + 0.999999);
+    if (rank < 1) {
+        rank = 1;
+    }
+    long seen = 0;
+    for (int k = 0; k < HISTOGRAM_BUCKETS && histogram->total > 0; k++) {
+        seen += histogram->counts[k];
+        if (seen >= rank) {
+            long high = histogram_bucket_high(k);
+            return high < histogram->max ? high : histogram->max;
         }
     }
-    return total_free;
+    return 0;
 }
 
-// Add a process to the waiting queue when immediate memory allocation is not possible
-int add_to_wait_queue(SystemMemory *sys, int process_id, int size) {
-    // Check if wait queue is full
-    if (sys->wait_queue_count >= MAX_WAIT_QUEUE) {
-        printf("Wait queue is full. Cannot add process %d\n", process_id);
-        return 0;
+// Reset a free-block index to empty, keeping its node pool for reuse
+void free_index_clear(FreeIndex *index) {
+    index->used = 0;
+    index->free_list = -1;
+    index->root = -1;
+    index->seed = 2463534242u;
+}
+
+// Release the node pool of a free-block index
+void free_index_destroy(FreeIndex *index) {
+    free(index->nodes);
+    memset(index, 0, sizeof(FreeIndex));
+    index->free_list = -1;
+    index->root = -1;
+}
+
+// Largest free size stored under a node (0 for an empty subtree)
+static inline kb_t free_index_max(const FreeIndex *index, int node) {
+    return node < 0 ? 0 : index->nodes[node].max_size;
+}
+
+// Recompute a node's subtree maximum from its children
+static inline void free_index_update(FreeIndex *index, int node) {
+    FreeIndexNode *n = &index->nodes[node];
+    kb_t best = n->size;
+    kb_t left_max = free_index_max(index, n->left);
+    kb_t right_max = free_index_max(index, n->right);
+    if (left_max > best) {
+        best = left_max;
     }
+    if (right_max > best) {
+        best = right_max;
+    }
+    n->max_size = best;
+}
 
-    // Circular queue implementation: move rear and add process
-    sys->wait_queue_rear = (sys->wait_queue_rear + 1) % MAX_WAIT_QUEUE;
-    sys->wait_queue[sys->wait_queue_rear].process_id = process_id;
-    sys->wait_queue[sys->wait_queue_rear].memory_size = size;
-    sys->wait_queue_count++;
+// Whether a node orders before the key (size, start)
+static inline int free_index_before(const FreeIndex *index, int node, kb_t size, kb_t start) {
+    const FreeIndexNode *n = &index->nodes[node];
+    if (index->by_size && n->size != size) {
+        return n->size < size;
+    }
+    return n->start < start;
+}
 
-    printf("Process %d added to wait queue due to insufficient memory\n", process_id);
-    return 1;
+// Split the subtree at `node` into keys below (size, start) (*left) and the rest (*right)
+void free_index_split(FreeIndex *index, int node, kb_t size, kb_t start, int *left, int *right) {
+    if (node < 0) {
+        *left = -1;
+        *right = -1;
+        return;
+    }
+    if (free_index_before(index, node, size, start)) {
+        free_index_split(index, index->nodes[node].right, size, start, &index->nodes[node].right, right);
+        *left = node;
+    } else {
+        free_index_split(index, index->nodes[node].left, size, start, left, &index->nodes[node].left);
+        *right = node;
+    }
+    free_index_update(index, node);
 }
 
-// Attempt to allocate memory for a process waiting in the queue
-int try_allocate_waiting_process(SystemMemory *sys) {
-    // If no processes are waiting, return immediately
-    if (sys->wait_queue_count == 0) {
-        return 0;
+// Join two subtrees where every key in `left` is below every key in `right`
+int free_index_merge(FreeIndex *index, int left, int right) {
+    if (left < 0) {
+        return right;
+    }
+    if (right < 0) {
+        return left;
     }
+    if (index->nodes[left].priority > index->nodes[right].priority) {
+        index->nodes[left].right = free_index_merge(index, index->nodes[left].right, right);
+        free_index_update(index, left);
+        return left;
+    }
+    index->nodes[right].left = free_index_merge(index, left, index->nodes[right].left);
+    free_index_update(index, right);
+    return right;
+}
 
-    // Get the process at the front of the waiting queue
-    WaitingProcess *current_waiting = &sys->wait_queue[sys->wait_queue_front];
-    
-    // Check if total free memory is sufficient for the waiting process
-    int total_free = get_total_free_memory(sys);
-    if (total_free < current_waiting->memory_size) {
-        return 0; // Not enough total memory yet
-    }
-
-    // Try to allocate memory for the waiting process using first-fit algorithm
-    int address = first_fit_allocate(sys, current_waiting->process_id, current_waiting->memory_size);
-    
-    if (address != -1) {
-        // Successfully allocated memory, remove from wait queue
-        sys->wait_queue_front = (sys->wait_queue_front + 1) % MAX_WAIT_QUEUE;
-        sys->wait_queue_count--;
-        printf("Process %d moved from waiting queue and allocated memory\n", 
-               current_waiting->process_id);
-        return 1;
+// Make sure the next `count` insertions cannot fail for lack of pool nodes
+// Returns 0 on success, -1 if the node pool could not be grown
+int free_index_reserve(FreeIndex *index, int count) {
+    return ensure_capacity((void **)&index->nodes, &index->capacity,
+                           index->used + count, sizeof(FreeIndexNode));
+}
+
+// Record a free block in the index
+// Returns 0 on success, -1 if the node pool could not be grown
+int free_index_insert(FreeIndex *index, kb_t start, kb_t size, int block) {
+    int node = index->free_list;
+    if (node >= 0) {
+        index->free_list = index->nodes[node].left;
+    } else {
+        if (free_index_reserve(index, 1) != 0) {
+            return -1;
+        }
+        node = index->used++;
     }
-    
+
+    // xorshift32 priorities keep the expected depth logarithmic
+    index->seed ^= index->seed << 13;
+    index->seed ^= index->seed >> 17;
+    index->seed ^= index->seed << 5;
+
+    FreeIndexNode *n = &index->nodes[node];
+    n->start = start;
+    n->size = size;
+    n->block = block;
+    n->max_size = size;
+    n->priority = index->seed;
+    n->left = -1;
+    n->right = -1;
+
+    int left, right;
+    free_index_split(index, index->root, size, start, &left, &right);
+    index->root = free_index_merge(index, free_index_merge(index, left, node), right);
     return 0;
 }
 
-// First Fit memory allocation strategy
-int first_fit_allocate(SystemMemory *sys, int process_id, int size) {
-    // Iterate through memory blocks to find first block that can accommodate the process
-    for (int i = 0; i < sys->num_blocks; i++) {
-        if (sys->blocks[i].is_free && sys->blocks[i].size >= size) {
-            // If block size exactly matches required size
-            if (sys->blocks[i].size == size) {
-                sys->blocks[i].is_free = 0;
-            } else {
-                // Split the block if it's larger than required
-                // Shift existing blocks to make space for new block
-                for (int j = sys->num_blocks; j > i + 1; j--) {
-                    sys->blocks[j] = sys->blocks[j - 1];
-                }
-                
-                // Create a new free block with remaining memory
-                sys->blocks[i + 1].start = sys->blocks[i].start + size;
-                sys->blocks[i + 1].size = sys->blocks[i].size - size;
-                sys->blocks[i + 1].is_free = 1;
+// Remove the free block starting at `start` with the given size from the index
+void free_index_remove(FreeIndex *index, kb_t start, kb_t size) {
+    int left, middle, right;
+    free_index_split(index, index->root, size, start, &left, &right);
+    free_index_split(index, right, size, start + 1, &middle, &right);
 
-                // Adjust original block
-                sys->blocks[i].size = size;
-                sys->num_blocks++;
-                sys->blocks[i].is_free = 0;
-            }
+    // Return the removed node (at most one, since starts are unique) to the pool
+    if (middle >= 0) {
+        index->nodes[middle].left = index->free_list;
+        index->free_list = middle;
+    }
+    index->root = free_index_merge(index, left, right);
+}
+
+// Find the lowest-address free block of at least `size` within a subtree (address order)
+// Returns its block pool index, or -1 if no free block is large enough
+int free_index_first_fit_in(FreeIndex *index, int node, kb_t size) {
+    if (free_index_max(index, node) < size) {
+        return -1;
+    }
+
+    // Prefer the left subtree, then this node, then the right subtree
+    while (node >= 0) {
+        const FreeIndexNode *n = &index->nodes[node];
+        STAT_INC(index->visits);
+        if (free_index_max(index, n->left) >= size) {
+            node = n->left;
+        } else if (n->size >= size) {
+            return n->block;
+        } else {
+            node = n->right;
+        }
+    }
+    return -1;
+}
+
+// Lowest-address free block of at least `size` starting at or after `from`, within a subtree
+int free_index_first_fit_from(FreeIndex *index, int node, kb_t size, kb_t from) {
+    if (node < 0 || index->nodes[node].max_size < size) {
+        return -1;
+    }
+    const FreeIndexNode *n = &index->nodes[node];
+    STAT_INC(index->visits);
+    if (n->start < from) {
+        return free_index_first_fit_from(index, n->right, size, from);
+    }
+
+    // This node is in range, so its whole right subtree is too
+    int found = free_index_first_fit_from(index, n->left, size, from);
+    if (found >= 0) {
+        return found;
+    }
+    if (n->size >= size) {
+        return n->block;
+    }
+    return free_index_first_fit_in(index, n->right, size);
+}
+
+// Find the lowest-address free block of at least `size` (address-ordered index)
+// Returns its block pool index, or -1 if no free block is large enough
+int free_index_first_fit(FreeIndex *index, kb_t size) {
+    return free_index_first_fit_in(index, index->root, size);
+}
+
+// Find the smallest free block of at least `size`, lowest address among equal sizes
+// (size-ordered index). Returns its block pool index, or -1 if none is large enough
+int free_index_best_fit(FreeIndex *index, kb_t size) {
+    int best = -1;
+    for (int node = index->root; node >= 0;) {
+        const FreeIndexNode *n = &index->nodes[node];
+        STAT_INC(index->visits);
+        if (n->size >= size) {
+            best = n->block;
+            node = n->left;
+        } else {
+            node = n->right;
+        }
+    }
+    return best;
+}
+
+// Grow the free array to hold at least `needed` blocks
+// Returns 0 on success, -1 if an array could not be grown
+int free_array_reserve(FreeArray *array, int needed) {
+    int capacity = array->capacity;
+    if (ensure_capacity((void **)&array->sizes, &capacity, needed, sizeof(kb_t)) != 0) {
+        return -1;
+    }
+    capacity = array->capacity;
+    if (ensure_capacity((void **)&array->starts, &capacity, needed, sizeof(kb_t)) != 0) {
+        return -1;
+    }
+    capacity = array->capacity;
+    if (ensure_capacity((void **)&array->blocks, &capacity, needed, sizeof(int)) != 0) {
+        return -1;
+    }
+    array->capacity = capacity;
+    return 0;
+}
 
-            // Record the process in active processes list
-            sys->processes[sys->num_processes].id = process_id;
-            sys->processes[sys->num_processes].memory_address = sys->blocks[i].start;
-            sys->processes[sys->num_processes].memory_size = size;
-            sys->processes[sys->num_processes].is_active = 1;
-            sys->num_processes++;
-            
-            return sys->blocks[i].start;
+// Position of the first free block starting at or after `start` (binary search)
+static inline int free_array_position(const FreeArray *array, kb_t start) {
+    int low = 0;
+    int high = array->count;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (array->starts[mid] < start) {
+            low = mid + 1;
+        } else {
+            high = mid;
         }
     }
+    return low;
+}
+
+// Release the arrays of a free array
+void free_array_destroy(FreeArray *array) {
+    free(array->sizes);
+    free(array->starts);
+    free(array->blocks);
+    memset(array, 0, sizeof(FreeArray));
+}
+
+// Make sure the next `count` block nodes can be taken without growing the pool
+// Returns 0 on success, -1 if the pool could not be grown
+int reserve_block_nodes(SystemMemory *sys, int count) {
+    if (ensure_capacity((void **)&sys->blocks, &sys->blocks_capacity,
+                        sys->blocks_used + count, sizeof(MemoryBlock)) != 0) {
+        return -1;
+    }
+    // The free array can hold every block, so adding a free block never has to grow it
+    return sys->free_array.capacity > 0 ? free_array_reserve(&sys->free_array, sys->blocks_capacity) : 0;
+}
+
+// Take an unused block node from the pool, recycling released slots first
+// Returns the pool index, or -1 if the pool could not be grown
+int new_block_node(SystemMemory *sys) {
+    int block = sys->free_block_slot;
+    if (block >= 0) {
+        sys->free_block_slot = sys->blocks[block].next;
+        return block;
+    }
+    if (reserve_block_nodes(sys, 1) != 0) {
+        return -1;
+    }
+    return sys->blocks_used++;
+}
+
+// Return a block node that has been unlinked from the address list to the pool
+void release_block_node(SystemMemory *sys, int block) {
+    sys->blocks[block].next = sys->free_block_slot;
+    sys->free_block_slot = block;
+}
+
+// Split `size` off the front of a block in O(1); the remainder becomes a new free block
+// linked right after it. Returns the remainder's pool index, or -1 if no node was available
+int split_block(SystemMemory *sys, int block, kb_t size) {
+    int rest = new_block_node(sys);
+    if (rest < 0) {
+        return -1;
+    }
+
+    MemoryBlock *b = &sys->blocks[block];
+    MemoryBlock *r = &sys->blocks[rest];
+    r->start = b->start + size;
+    r->size = b->size - size;
+    r->is_free = 1;
+    r->prev = block;
+    r->next = b->next;
+    if (b->next >= 0) {
+        sys->blocks[b->next].prev = rest;
+    }
+    b->next = rest;
+    b->size = size;
+    sys->num_blocks++;
+    STAT_INC(sys->stats.splits);
+    if (sys->num_blocks > sys->peak_blocks) {
+        sys->peak_blocks = sys->num_blocks;
+    }
+    return rest;
+}
+
+// Hash a process id to its home slot (Fibonacci hashing)
+static inline int process_map_home(const ProcessMap *map, int id) {
+    return (int)(((unsigned int)id * 2654435769u) & (unsigned int)(map->capacity - 1));
+}
 
-    // If no suitable block found, try to add to waiting queue
-    if (add_to_wait_queue(sys, process_id, size)) {
-        return -1; // Allocation failed
+// Find the process slot recorded for an id
+// Returns the slot, or -1 if the id is not in the map
+int process_map_find(const ProcessMap *map, int id) {
+    if (map->count == 0) {
+        return -1;
+    }
+    int mask = map->capacity - 1;
+    for (int i = process_map_home(map, id); map->entries[i].id != 0; i = (i + 1) & mask) {
+        if (map->entries[i].id == id) {
+            return map->entries[i].slot;
+        }
     }
     return -1;
 }
 
-// Free memory allocated to a specific process
-void free_memory(SystemMemory *sys, int process_id) {
-    // Find the process in the active processes list
-    for (int i = 0; i < sys->num_processes; i++) {
-        if (sys->processes[i].id == process_id && sys->processes[i].is_active) {
-            // Mark the process as inactive
-            sys->processes[i].is_active = 0;
-
-            // Find and free the corresponding memory block
-            for (int j = 0; j < sys->num_blocks; j++) {
-                if (sys->blocks[j].start == sys->processes[i].memory_address) {
-                    sys->blocks[j].is_free = 1;
-                    printf("Memory for Process %d freed\n", process_id);
-                    
-                    // Attempt to allocate memory for waiting processes
-                    while (try_allocate_waiting_process(sys));
-                    return;
-                }
+// Double the table (or create it) and re-insert every entry
+// Returns 0 on success, -1 if the table could not be allocated
+int process_map_grow(ProcessMap *map) {
+    int new_capacity = map->capacity > 0 ? map->capacity * 2 : 64;
+    ProcessMapEntry *entries = calloc((size_t)new_capacity, sizeof(ProcessMapEntry));
+    if (entries == NULL) {
+        return -1;
+    }
+
+    ProcessMap grown = {entries, new_capacity, map->count};
+    for (int i = 0; i < map->capacity; i++) {
+        if (map->entries[i].id != 0) {
+            int j = process_map_home(&grown, map->entries[i].id);
+            while (entries[j].id != 0) {
+                j = (j + 1) & (new_capacity - 1);
             }
+            entries[j] = map->entries[i];
         }
     }
-    printf("Process %d not found\n", process_id);
+    free(map->entries);
+    *map = grown;
+    return 0;
 }
 
-// Print detailed information about current memory layout
-void print_memory_layout(SystemMemory *sys) {
-    // Display details of all memory blocks
-    printf("Memory Blocks:\n");
-    for (int i = 0; i < sys->num_blocks; i++) {
-        printf("Block %d: Start_address=%d, Size=%dKB, %s\n",
-               i + 1,
-               sys->blocks[i].start,
-               sys->blocks[i].size,
-               sys->blocks[i].is_free ? "Free" : "Allocated");
+// Make sure one more id can be inserted without growing the table
+// Returns 0 on success, -1 if the table could not be grown
+int process_map_reserve(ProcessMap *map) {
+    if (2 * (map->count + 1) > map->capacity) {
+        return process_map_grow(map);
     }
+    return 0;
+}
 
-    // Display active processes
-    int active_count = 0;
-    printf("\nActive Processes:\n");
-    for (int i = 0; i < sys->num_processes; i++) {
-        if (sys->processes[i].is_active) {
-            printf("Process %d: Address=%d, Size=%dKB\n",
-                   sys->processes[i].id,
-                   sys->processes[i].memory_address,
-                   sys->processes[i].memory_size);
-            active_count++;
-        }
+// Record the slot of a process id that is not yet in the map
+// Call process_map_reserve() first so the table has room
+void process_map_insert(ProcessMap *map, int id, int slot) {
+    int mask = map->capacity - 1;
+    int i = process_map_home(map, id);
+    while (map->entries[i].id != 0) {
+        i = (i + 1) & mask;
     }
+    map->entries[i].id = id;
+    map->entries[i].slot = slot;
+    map->count++;
+}
 
-    // Handle case of no active processes
-    if (active_count == 0) {
-        printf("No active processes\n");
+// Remove a process id from the map using backward-shift deletion (no tombstones)
+void process_map_remove(ProcessMap *map, int id) {
+    if (map->count == 0) {
+        return;
+    }
+    int mask = map->capacity - 1;
+    int i = process_map_home(map, id);
+    while (map->entries[i].id != id) {
+        if (map->entries[i].id == 0) {
+            return;
+        }
+        i = (i + 1) & mask;
     }
 
-    // Display waiting queue
-    printf("\nWaiting Queue:\n");
-    if (sys->wait_queue_count == 0) {
-        printf("No processes waiting\n");
-    } else {
-        for (int i = 0; i < sys->wait_queue_count; i++) {
-            int index = (sys->wait_queue_front + i) % MAX_WAIT_QUEUE;
-            printf("Process %d: Waiting for %dKB\n", 
-                   sys->wait_queue[index].process_id, 
-                   sys->wait_queue[index].memory_size);
+    // Pull later entries of the probe run back into the hole when their home allows it
+    int hole = i;
+    for (int j = (hole + 1) & mask; map->entries[j].id != 0; j = (j + 1) & mask) {
+        int home = process_map_home(map, map->entries[j].id);
+        if (((j - home) & mask) >= ((j - hole) & mask)) {
+            map->entries[hole] = map->entries[j];
+            hole = j;
         }
     }
-    printf("\n---------------------------------------------\n\n");
+    map->entries[hole].id = 0;
+    map->count--;
 }
 
-// Display interactive menu options
-void display_menu() {
-    printf("--Main Menu--\n");
-    printf("1. Allocate Memory\n");
-    printf("2. Free Memory\n");
-    printf("3. Exit\n");
-    printf("Enter your choice: ");
+// Take an unused process record, recycling the slots of freed processes first
+// Call after ensuring capacity for one more record
+int new_process_slot(SystemMemory *sys) {
+    int slot = sys->free_process_slot;
+    if (slot >= 0) {
+        sys->free_process_slot = sys->processes[slot].block;
+        return slot;
+    }
+    return sys->processes_used++;
 }
 
-int main() {
-    SystemMemory system_memory;
+// Return the record of a freed process to the slot pool
+void release_process_slot(SystemMemory *sys, int slot) {
+    sys->processes[slot].is_active = 0;
+    sys->processes[slot].block = sys->free_process_slot;
+    sys->free_process_slot = slot;
+}
 
-    printf("System Limitations:\n");
-    printf("- Maximum Memory Blocks: %d\n", MAX_BLOCKS);
-    printf("- Maximum Processes: %d\n", MAX_PROCESSES);
-    printf("- Maximum Waiting Queue Size: %d\n", MAX_WAIT_QUEUE);
-    printf("---------------------------------------------\n");
+// Absorb the block following `block` into it in O(1); both must be free
+void merge_with_next(SystemMemory *sys, int block) {
+    MemoryBlock *b = &sys->blocks[block];
+    int next = b->next;
+    MemoryBlock *n = &sys->blocks[next];
 
-    // Get number of memory blocks from user
-    int num_blocks = get_valid_integer("Enter the number of memory blocks you want to simulate: ", 1, MAX_BLOCKS);
+    b->size += n->size;
+    b->next = n->next;
+    if (n->next >= 0) {
+        sys->blocks[n->next].prev = block;
+    }
+    release_block_node(sys, next);
+    sys->num_blocks--;
+    sys->free_block_count--;
+    sys->merges++;
+}
 
-    // Get sizes for each memory block
-    int block_sizes[MAX_BLOCKS];
-    for (int i = 0; i < num_blocks; i++) {
-        char prompt[50];
-        snprintf(prompt, sizeof(prompt), "Enter size of memory block %d (in KB): ", i + 1);
-        block_sizes[i] = get_valid_integer(prompt, 1, INT_MAX);
+// Account for a free block that has just grown to `size` (freed or merged)
+static inline void note_free_block_size(SystemMemory *sys, kb_t size) {
+    if (size > sys->largest_free) {
+        sys->largest_free = size;
+    }
+}
+
+// Add a block that has become free to the free-block index of `strategy`
+ENGINE_INLINE void index_free_block_as(SystemMemory *sys, const PlacementStrategy *strategy, int block) {
+    if (strategy->add_free != NULL) {
+        strategy->add_free(sys, block);
     }
+}
 
-    // Initialize memory system
-    initialize_memory(&system_memory, num_blocks, block_sizes);
+// Remove a free block from the index of `strategy` before it is allocated, resized or merged away
+ENGINE_INLINE void unindex_free_block_as(SystemMemory *sys, const PlacementStrategy *strategy, int block) {
+    if (strategy->remove_free != NULL) {
+        strategy->remove_free(sys, block);
+    }
+}
 
-    // Variables for process management
-    int choice, size, process_id = 1;
+// Add a block that has become free to the strategy's free-block index
+static inline void index_free_block(SystemMemory *sys, int block) {
+    index_free_block_as(sys, sys->strategy, block);
+}
 
-    // Main program loop
-    while (1) {
-        printf("\n----First Fit Memory Allocation Simulator----\n\n");
-        print_memory_layout(&system_memory);  // Display current memory state
-        display_menu();  // Show menu options
-        choice = get_valid_integer("", 1, 3);
+// Remove a free block from the strategy's index before it is allocated, resized or merged away
+static inline void unindex_free_block(SystemMemory *sys, int block) {
+    unindex_free_block_as(sys, sys->strategy, block);
+}
 
-        // Handle user choices
-        switch (choice) {
-            case 1:  // Allocate Memory
-                size = get_valid_integer("Enter memory size to allocate (in KB): ", 1, INT_MAX);
+// Split `size` off the front of a free block that is being allocated and index the
+// free remainder. Callers reserve a block node first, so the split cannot fail.
+ENGINE_INLINE void split_free_remainder_as(SystemMemory *sys, const PlacementStrategy *strategy, int block,
+                                           kb_t size) {
+    int rest = split_block(sys, block, size);
+    sys->free_block_count++;
+    index_free_block_as(sys, strategy, rest);
+}
 
-                // Attempt to allocate memory
-                int address = first_fit_allocate(&system_memory, process_id++, size);
-                if (address != -1) {
-                    printf("Memory allocated at address %d\n", address);
-                } else {
-                    printf("Process added to wait queue\n");
-                }
-                break;
+void split_free_remainder(SystemMemory *sys, int block, kb_t size) {
+    split_free_remainder_as(sys, sys->strategy, block, size);
+}
 
-            case 2:  // Free Memory
-                size = get_valid_integer("Enter process number (ID) to free memory: ", 1, process_id - 1);
-                free_memory(&system_memory, size);
+// Merge a newly freed block with its free neighbours on either side
+// Returns the pool index of the resulting (possibly larger) free block
+ENGINE_INLINE int coalesce_block_as(SystemMemory *sys, const PlacementStrategy *strategy, int block) {
+    int prev = sys->blocks[block].prev;
+    if (prev >= 0 && sys->blocks[prev].is_free) {
+        unindex_free_block_as(sys, strategy, prev);
+        merge_with_next(sys, prev);
+        block = prev;
+    }
+
+    int next = sys->blocks[block].next;
+    if (next >= 0 && sys->blocks[next].is_free) {
+        unindex_free_block_as(sys, strategy, next);
+        merge_with_next(sys, block);
+    }
+    return block;
+}
+
+// Merge every run of adjacent free blocks in a single address-ordered pass
+// Used by deferred coalescing once an allocation finds no fitting block
+void coalesce_all(SystemMemory *sys) {
+    for (int b = sys->first_block; b >= 0; b = sys->blocks[b].next) {
+        int next = sys->blocks[b].next;
+        if (!sys->blocks[b].is_free || next < 0 || !sys->blocks[next].is_free) {
+            continue;
+        }
+
+        // Pull the whole run out of the index and re-insert it as one block
+        unindex_free_block(sys, b);
+        while (next >= 0 && sys->blocks[next].is_free) {
+            unindex_free_block(sys, next);
+            merge_with_next(sys, b);
+            next = sys->blocks[b].next;
+        }
+        note_free_block_size(sys, sys->blocks[b].size);
+        index_free_block(sys, b);
+    }
+    sys->pending_coalesce = 0;
+    sys->coalesce_passes++;
+}
+
+// Elapsed wall-clock time between two monotonic timestamps, in seconds
+double elapsed_seconds(const struct timespec *start, const struct timespec *end) {
+    return (double)(end->tv_sec - start->tv_sec) +
+           (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Slide every allocated block down to the lowest addresses, keeping their order, and gather
+// all free space into one block at the top of memory. Process addresses follow their blocks.
+// Returns 0 on success, -1 if the strategy's block layout cannot be moved (buddy)
+int compact_memory(SystemMemory *sys) {
+    // Strategies with their own merge rule depend on block alignment that sliding breaks
+    if (sys->strategy->coalesce != NULL) {
+        if (sys->verbose) {
+            printf("Compaction is not available with the %s strategy\n", sys->strategy->name);
+        }
+        return -1;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Every free block leaves the index; an index that can be emptied at once is, rather than
+    // shifting or rebalancing it once per block. Only the tail block is indexed again.
+    const PlacementStrategy *strategy = sys->strategy;
+    if (strategy->clear_free != NULL) {
+        strategy->clear_free(sys);
+    }
+
+    // Relink the allocated blocks back to back; keep one free node for the tail block
+    kb_t address = 0;
+    int last = -1;
+    int tail = -1;
+    long moved = 0;
+    int b = sys->first_block;
+    sys->first_block = -1;
+    while (b >= 0) {
+        int next = sys->blocks[b].next;
+        MemoryBlock *block = &sys->blocks[b];
+        if (block->is_free) {
+            if (strategy->clear_free == NULL) {
+                unindex_free_block(sys, b);
+            }
+            if (tail < 0) {
+                tail = b;
+            } else {
+                release_block_node(sys, b);
+                sys->num_blocks--;
+            }
+        } else {
+            if (block->start != address) {
+                block->start = address;
+                moved += block->size;
+            }
+            address += block->size;
+            block->prev = last;
+            if (last >= 0) {
+                sys->blocks[last].next = b;
+            } else {
+                sys->first_block = b;
+            }
+            last = b;
+        }
+        b = next;
+    }
+
+    // The free space, if any, becomes a single block after the last allocated one
+    if (tail >= 0) {
+        sys->blocks[tail].start = address;
+        sys->blocks[tail].size = sys->total_memory - address;
+        sys->blocks[tail].prev = last;
+        if (last >= 0) {
+            sys->blocks[last].next = tail;
+        } else {
+            sys->first_block = tail;
+        }
+        last = tail;
+    }
+    if (last >= 0) {
+        sys->blocks[last].next = -1;
+    }
+
+    // Point every active process at its block's new address
+    for (int i = 0; i < sys->processes_used; i++) {
+        if (sys->processes[i].is_active) {
+            sys->processes[i].memory_address = sys->blocks[sys->processes[i].block].start;
+        }
+    }
+
+    // Reset the free-space bookkeeping to the single tail block
+    sys->free_block_count = tail >= 0;
+    sys->largest_free = tail >= 0 ? sys->blocks[tail].size : 0;
+    sys->largest_stale = 0;
+    sys->pending_coalesce = 0;
+    sys->rover = address;
+    if (tail >= 0) {
+        index_free_block(sys, tail);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    sys->compactions++;
+    sys->compaction_moved += moved;
+    sys->compaction_seconds += elapsed_seconds(&start, &end);
+    if (sys->verbose) {
+        printf("Memory compacted: %ldKB moved, %" PRIkb "KB free in one block\n", moved,
+               sys->total_memory - address);
+    }
+    return 0;
+}
+
+// Tree-indexed strategies: record a free block in free_index
+// Insertion cannot fail because callers reserve a node first
+void tree_add_free(SystemMemory *sys, int block) {
+    free_index_insert(&sys->free_index, sys->blocks[block].start, sys->blocks[block].size, block);
+}
+
+// Tree-indexed strategies: drop a free block from free_index
+void tree_remove_free(SystemMemory *sys, int block) {
+    free_index_remove(&sys->free_index, sys->blocks[block].start, sys->blocks[block].size);
+}
+
+// Tree-indexed strategies: drop every free block from free_index, keeping its node pool
+void tree_clear_free(SystemMemory *sys) {
+    free_index_clear(&sys->free_index);
+}
+
+// First fit by linear scan: walk the blocks in address order to find the first
+// block that can accommodate the process. This is the reference placement.
+int find_first_fit_linear(SystemMemory *sys, kb_t size) {
+    for (int b = sys->first_block; b >= 0; b = sys->blocks[b].next) {
+        STAT_INC(sys->stats.blocks_scanned);
+        if (sys->blocks[b].is_free && sys->blocks[b].size >= size) {
+            return b;
+        }
+    }
+    return -1;
+}
+
+// First fit through the address-ordered max-size index in O(log n)
+int find_first_fit_indexed(SystemMemory *sys, kb_t size) {
+    return free_index_first_fit(&sys->free_index, size);
+}
+
+// Index of the first of `count` sizes that is at least `size` (>= 1), or `count` if none is.
+// Compares 16 sizes per step with AVX2, SSE or NEON, and finishes with a scalar loop. Plain
+// SSE2 has no 64-bit compare, so there sizes are subtracted from `size - 1` instead: with
+// both in [0, KB_MAX] the difference is negative exactly when the size fits.
+static inline int first_size_at_least(const kb_t *sizes, int count, kb_t size) {
+    int i = 0;
+#if defined(FF_ADDR32) && defined(__AVX2__)
+    const __m256i below = _mm256_set1_epi32(size - 1);
+    for (; i + 16 <= count; i += 16) {
+        __m256i low = _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i *)(sizes + i)), below);
+        __m256i high = _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i *)(sizes + i + 8)), below);
+        unsigned int mask = (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(low)) |
+                            (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(high)) << 8;
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#elif defined(FF_ADDR32) && defined(__SSE2__)
+    const __m128i below = _mm_set1_epi32(size - 1);
+    for (; i + 16 <= count; i += 16) {
+        unsigned int mask = 0;
+        for (int lane = 0; lane < 4; lane++) {
+            __m128i fits = _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i *)(sizes + i + 4 * lane)), below);
+            mask |= (unsigned int)_mm_movemask_ps(_mm_castsi128_ps(fits)) << (4 * lane);
+        }
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#elif defined(FF_ADDR32) && defined(__ARM_NEON) && defined(__aarch64__)
+    const int32x4_t below = vdupq_n_s32(size - 1);
+    for (; i + 16 <= count; i += 16) {
+        uint32x4_t fits = vorrq_u32(vorrq_u32(vcgtq_s32(vld1q_s32(sizes + i), below),
+                                              vcgtq_s32(vld1q_s32(sizes + i + 4), below)),
+                                    vorrq_u32(vcgtq_s32(vld1q_s32(sizes + i + 8), below),
+                                              vcgtq_s32(vld1q_s32(sizes + i + 12), below)));
+        if (vmaxvq_u32(fits) != 0) {
+            break;
+        }
+    }
+#elif !defined(FF_ADDR32) && defined(__AVX2__)
+    const __m256i below = _mm256_set1_epi64x(size - 1);
+    for (; i + 16 <= count; i += 16) {
+        unsigned int mask = 0;
+        for (int lane = 0; lane < 4; lane++) {
+            __m256i fits = _mm256_cmpgt_epi64(_mm256_loadu_si256((const __m256i *)(sizes + i + 4 * lane)), below);
+            mask |= (unsigned int)_mm256_movemask_pd(_mm256_castsi256_pd(fits)) << (4 * lane);
+        }
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#elif !defined(FF_ADDR32) && defined(__SSE4_2__)
+    const __m128i below = _mm_set1_epi64x(size - 1);
+    for (; i + 16 <= count; i += 16) {
+        unsigned int mask = 0;
+        for (int lane = 0; lane < 8; lane++) {
+            __m128i fits = _mm_cmpgt_epi64(_mm_loadu_si128((const __m128i *)(sizes + i + 2 * lane)), below);
+            mask |= (unsigned int)_mm_movemask_pd(_mm_castsi128_pd(fits)) << (2 * lane);
+        }
+        if (mask != 0) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#elif !defined(FF_ADDR32) && defined(__SSE2__)
+    const __m128i below = _mm_set1_epi64x(size - 1);
+    for (; i + 16 <= count; i += 16) {
+        __m128i fits = _mm_sub_epi64(below, _mm_loadu_si128((const __m128i *)(sizes + i)));
+        for (int lane = 1; lane < 8; lane++) {
+            fits = _mm_or_si128(fits, _mm_sub_epi64(below, _mm_loadu_si128((const __m128i *)(sizes + i + 2 * lane))));
+        }
+        if (_mm_movemask_pd(_mm_castsi128_pd(fits)) != 0) {
+            break;
+        }
+    }
+#elif !defined(FF_ADDR32) && defined(__ARM_NEON) && defined(__aarch64__)
+    const int64x2_t below = vdupq_n_s64(size - 1);
+    for (; i + 16 <= count; i += 16) {
+        uint64x2_t fits = vcgtq_s64(vld1q_s64(sizes + i), below);
+        for (int lane = 1; lane < 8; lane++) {
+            fits = vorrq_u64(fits, vcgtq_s64(vld1q_s64(sizes + i + 2 * lane), below));
+        }
+        if ((vgetq_lane_u64(fits, 0) | vgetq_lane_u64(fits, 1)) != 0) {
+            break;
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        if (sizes[i] >= size) {
+            return i;
+        }
+    }
+    return count;
+}
+
+// First fit over the free array: a vector scan of the free block sizes in address order.
+// No allocated block is visited and no pointer is chased, so for block counts that fit
+// in cache this beats both the linked scan and the tree. Kept out of line: inlined into the
+// specialized engines, the vector loop compiles about 10% slower.
+__attribute__((noinline)) int find_first_fit_simd(SystemMemory *sys, kb_t size) {
+    const FreeArray *array = &sys->free_array;
+    int i = first_size_at_least(array->sizes, array->count, size);
+    STAT_ADD(sys->stats.blocks_scanned, i < array->count ? i + 1 : i);
+    return i < array->count ? array->blocks[i] : -1;
+}
+
+// SIMD first fit: insert a free block at its address position
+// Cannot fail because the arrays are kept as long as the block pool
+void simd_add_free(SystemMemory *sys, int block) {
+    FreeArray *array = &sys->free_array;
+    int i = free_array_position(array, sys->blocks[block].start);
+    int moved = array->count - i;
+    memmove(array->sizes + i + 1, array->sizes + i, (size_t)moved * sizeof(kb_t));
+    memmove(array->starts + i + 1, array->starts + i, (size_t)moved * sizeof(kb_t));
+    memmove(array->blocks + i + 1, array->blocks + i, (size_t)moved * sizeof(int));
+    array->sizes[i] = sys->blocks[block].size;
+    array->starts[i] = sys->blocks[block].start;
+    array->blocks[i] = block;
+    array->count++;
+}
+
+// SIMD first fit: close the gap left by a free block
+void simd_remove_free(SystemMemory *sys, int block) {
+    FreeArray *array = &sys->free_array;
+    int i = free_array_position(array, sys->blocks[block].start);
+    int moved = array->count - i - 1;
+    memmove(array->sizes + i, array->sizes + i + 1, (size_t)moved * sizeof(kb_t));
+    memmove(array->starts + i, array->starts + i + 1, (size_t)moved * sizeof(kb_t));
+    memmove(array->blocks + i, array->blocks + i + 1, (size_t)moved * sizeof(int));
+    array->count--;
+}
+
+// SIMD first fit: drop every free block without shifting the arrays
+void simd_clear_free(SystemMemory *sys) {
+    sys->free_array.count = 0;
+}
+
+// SIMD first fit: size the free array for the whole block pool
+// Returns 0 on success, -1 if the arrays could not be allocated
+int simd_prepare(SystemMemory *sys) {
+    return free_array_reserve(&sys->free_array, sys->blocks_capacity);
+}
+
+// Next fit: first fit starting at the roving pointer, wrapping around to address 0
+int find_next_fit(SystemMemory *sys, kb_t size) {
+    int b = free_index_first_fit_from(&sys->free_index, sys->free_index.root, size, sys->rover);
+    return b >= 0 ? b : free_index_first_fit(&sys->free_index, size);
+}
+
+// Move the next-fit roving pointer past the block just allocated
+void advance_next_fit_rover(SystemMemory *sys, int block, kb_t size) {
+    sys->rover = sys->blocks[block].start + size;
+}
+
+// Best fit: smallest free block that fits, lowest address among equal sizes
+int find_best_fit(SystemMemory *sys, kb_t size) {
+    return free_index_best_fit(&sys->free_index, size);
+}
+
+// Worst fit: largest free block, lowest address among equal sizes
+int find_worst_fit(SystemMemory *sys, kb_t size) {
+    kb_t largest = free_index_max(&sys->free_index, sys->free_index.root);
+    return largest < size ? -1 : free_index_best_fit(&sys->free_index, largest);
+}
+
+// Segregated fit: size class of a block, i.e. the last class whose lower bound is <= size
+int size_class_of(const SystemMemory *sys, kb_t size) {
+    int low = 0;
+    int high = sys->num_classes - 1;
+    while (low < high) {
+        int mid = (low + high + 1) / 2;
+        if (sys->class_bounds[mid] <= size) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+// Segregated fit: round a request up to the bound of the smallest class that holds it.
+// Requests above the largest class bound are served with an exact-size block.
+kb_t segregated_block_size(SystemMemory *sys, kb_t size) {
+    int k = size_class_of(sys, size);
+    if (sys->class_bounds[k] == size || k == sys->num_classes - 1) {
+        return size;
+    }
+    return sys->class_bounds[k + 1];
+}
+
+// Segregated fit: push a free block on the front of its class's free list
+void segregated_add_free(SystemMemory *sys, int block) {
+    int k = size_class_of(sys, sys->blocks[block].size);
+    MemoryBlock *b = &sys->blocks[block];
+    b->free_prev = -1;
+    b->free_next = sys->bin_heads[k];
+    if (b->free_next >= 0) {
+        sys->blocks[b->free_next].free_prev = block;
+    }
+    sys->bin_heads[k] = block;
+    sys->bin_bitmap |= 1ULL << k;
+}
+
+// Segregated fit: unlink a free block from its class's free list in O(1)
+void segregated_remove_free(SystemMemory *sys, int block) {
+    int k = size_class_of(sys, sys->blocks[block].size);
+    MemoryBlock *b = &sys->blocks[block];
+    if (b->free_prev >= 0) {
+        sys->blocks[b->free_prev].free_next = b->free_next;
+    } else {
+        sys->bin_heads[k] = b->free_next;
+        if (b->free_next < 0) {
+            sys->bin_bitmap &= ~(1ULL << k);
+        }
+    }
+    if (b->free_next >= 0) {
+        sys->blocks[b->free_next].free_prev = b->free_prev;
+    }
+}
+
+// Segregated fit: every block in the request's own class or above fits a rounded request,
+// so take the head of the first non-empty bin found through the bitmap. Only an oversized
+// exact request has to search the top bin.
+int find_segregated_fit(SystemMemory *sys, kb_t size) {
+    int k = size_class_of(sys, size);
+    if (sys->class_bounds[k] == size) {
+        unsigned long long candidates = sys->bin_bitmap & (~0ULL << k);
+        STAT_INC(sys->stats.blocks_scanned);
+        return candidates == 0 ? -1 : sys->bin_heads[__builtin_ctzll(candidates)];
+    }
+    for (int b = sys->bin_heads[k]; b >= 0; b = sys->blocks[b].free_next) {
+        STAT_INC(sys->stats.blocks_scanned);
+        if (sys->blocks[b].size >= size) {
+            return b;
+        }
+    }
+    return -1;
+}
+
+// Buddy: bit position of the block of `order` starting at `start`
+static inline long buddy_bit(const SystemMemory *sys, int order, kb_t start) {
+    return sys->buddy_offset[order] + (long)(start >> order);
+}
+
+// Buddy: order of a power-of-two block size
+static inline int buddy_order(kb_t size) {
+    return __builtin_ctzll((unsigned long long)size);
+}
+
+// Buddy: whether a free block of `order` starts at `start`
+static inline int buddy_is_free(const SystemMemory *sys, int order, kb_t start) {
+    long bit = buddy_bit(sys, order, start);
+    return (sys->buddy_bits[bit >> 3] >> (bit & 7)) & 1;
+}
+
+// Buddy: round a request up to the next power of two (2^BUDDY_MAX_ORDER at most)
+kb_t buddy_block_size(SystemMemory *sys, kb_t size) {
+    (void)sys;
+    if (size > (1 << BUDDY_MAX_ORDER)) {
+        return size;
+    }
+    kb_t block_size = 1;
+    while (block_size < size) {
+        block_size <<= 1;
+    }
+    return block_size;
+}
+
+// Buddy: file a free block in its order's free list and mark it in the bitmap
+void buddy_add_free(SystemMemory *sys, int block) {
+    long bit = buddy_bit(sys, buddy_order(sys->blocks[block].size), sys->blocks[block].start);
+    sys->buddy_bits[bit >> 3] |= (unsigned char)(1u << (bit & 7));
+    segregated_add_free(sys, block);
+}
+
+// Buddy: unlink a free block from its order's free list and clear its bitmap bit
+void buddy_remove_free(SystemMemory *sys, int block) {
+    long bit = buddy_bit(sys, buddy_order(sys->blocks[block].size), sys->blocks[block].start);
+    sys->buddy_bits[bit >> 3] &= (unsigned char)~(1u << (bit & 7));
+    segregated_remove_free(sys, block);
+}
+
+// Buddy: halve a chosen block until it matches the request, freeing each upper half
+// as the buddy of the lower one; at most BUDDY_MAX_ORDER splits
+void buddy_carve(SystemMemory *sys, int block, kb_t size) {
+    while (sys->blocks[block].size > size) {
+        split_free_remainder(sys, block, sys->blocks[block].size / 2);
+    }
+}
+
+// Buddy: merge a freed block with its buddy for as long as the buddy is a whole free
+// block of the same order. A free buddy is always the adjacent block, so each step is O(1).
+int buddy_coalesce(SystemMemory *sys, int block) {
+    while (sys->blocks[block].size < (1 << BUDDY_MAX_ORDER)) {
+        kb_t size = sys->blocks[block].size;
+        int order = buddy_order(size);
+        kb_t buddy_start = sys->blocks[block].start ^ size;
+        if (buddy_start + size > sys->total_memory || !buddy_is_free(sys, order, buddy_start)) {
+            break;
+        }
+
+        int buddy = buddy_start > sys->blocks[block].start ? sys->blocks[block].next
+                                                           : sys->blocks[block].prev;
+        buddy_remove_free(sys, buddy);
+        if (buddy_start < sys->blocks[block].start) {
+            merge_with_next(sys, buddy);
+            block = buddy;
+        } else {
+            merge_with_next(sys, block);
+        }
+    }
+    return block;
+}
+
+// Buddy: re-tile the whole address space as maximal aligned power-of-two blocks,
+// use power-of-two size classes as the order free lists and allocate the bitmaps
+// Returns 0 on success, -1 if the bitmaps or block nodes could not be allocated
+int buddy_prepare(SystemMemory *sys) {
+    sys->num_classes = 0;
+    for (int k = 0; k <= BUDDY_MAX_ORDER; k++) {
+        sys->class_bounds[sys->num_classes++] = 1 << k;
+    }
+
+    long bits = 0;
+    for (int k = 0; k <= BUDDY_MAX_ORDER; k++) {
+        sys->buddy_offset[k] = bits;
+        bits += (long)(sys->total_memory >> k) + 1;
+    }
+    sys->buddy_bits = calloc((size_t)(bits + 7) / 8, 1);
+    if (sys->buddy_bits == NULL) {
+        return -1;
+    }
+
+    // Rebuild the block list from scratch
+    sys->blocks_used = 0;
+    sys->free_block_slot = -1;
+    sys->first_block = -1;
+    sys->num_blocks = 0;
+    sys->largest_free = 0;
+    int prev = -1;
+    for (kb_t start = 0; start < sys->total_memory;) {
+        kb_t size = 1 << BUDDY_MAX_ORDER;
+        while ((start & (size - 1)) != 0 || size > sys->total_memory - start) {
+            size >>= 1;
+        }
+
+        int block = new_block_node(sys);
+        if (block < 0) {
+            return -1;
+        }
+        sys->blocks[block].start = start;
+        sys->blocks[block].size = size;
+        sys->blocks[block].is_free = 1;
+        sys->blocks[block].prev = prev;
+        sys->blocks[block].next = -1;
+        if (prev >= 0) {
+            sys->blocks[prev].next = block;
+        } else {
+            sys->first_block = block;
+        }
+        note_free_block_size(sys, size);
+        sys->num_blocks++;
+        prev = block;
+        start += size;
+    }
+    sys->free_block_count = sys->num_blocks;
+    return 0;
+}
+
+// Available placement strategies
+const PlacementStrategy FIRST_FIT_LINEAR = {
+    "first-fit", -1, NULL, find_first_fit_linear, NULL, NULL, NULL, NULL, NULL, NULL, NULL
+};
+const PlacementStrategy FIRST_FIT_INDEXED = {
+    "first-fit", 0, NULL, find_first_fit_indexed, tree_add_free, tree_remove_free, tree_clear_free,
+    NULL, NULL, NULL, NULL
+};
+const PlacementStrategy FIRST_FIT_SIMD = {
+    "first-fit", -1, NULL, find_first_fit_simd, simd_add_free, simd_remove_free, simd_clear_free,
+    NULL, NULL, NULL, simd_prepare
+};
+const PlacementStrategy NEXT_FIT = {
+    "next-fit", 0, NULL, find_next_fit, tree_add_free, tree_remove_free, tree_clear_free,
+    advance_next_fit_rover, NULL, NULL, NULL
+};
+const PlacementStrategy BEST_FIT = {
+    "best-fit", 1, NULL, find_best_fit, tree_add_free, tree_remove_free, tree_clear_free,
+    NULL, NULL, NULL, NULL
+};
+const PlacementStrategy WORST_FIT = {
+    "worst-fit", 1, NULL, find_worst_fit, tree_add_free, tree_remove_free, tree_clear_free,
+    NULL, NULL, NULL, NULL
+};
+const PlacementStrategy SEGREGATED_FIT = {
+    "segregated", -1, segregated_block_size, find_segregated_fit,
+    segregated_add_free, segregated_remove_free, NULL, NULL, NULL, NULL, NULL
+};
+const PlacementStrategy BUDDY = {
+    "buddy", -1, buddy_block_size, find_segregated_fit, buddy_add_free, buddy_remove_free, NULL,
+    NULL, buddy_carve, buddy_coalesce, buddy_prepare
+};
+
+// Look up a placement strategy by name; `use_index` picks the first-fit variant
+// (INDEX_LINEAR, INDEX_TREE or INDEX_SIMD)
+// Returns NULL for an unknown name
+const PlacementStrategy *find_strategy(const char *name, int use_index) {
+    if (strcmp(name, "first-fit") == 0) {
+        return use_index == INDEX_SIMD ? &FIRST_FIT_SIMD :
+               use_index == INDEX_TREE ? &FIRST_FIT_INDEXED : &FIRST_FIT_LINEAR;
+    }
+    const PlacementStrategy *others[] = {&NEXT_FIT, &BEST_FIT, &WORST_FIT, &SEGREGATED_FIT, &BUDDY};
+    for (size_t i = 0; i < sizeof(others) / sizeof(others[0]); i++) {
+        if (strcmp(name, others[i]->name) == 0) {
+            return others[i];
+        }
+    }
+    return NULL;
+}
+
+// Every placement strategy, numbered for snapshot files
+const PlacementStrategy *const STRATEGIES[] = {
+    &FIRST_FIT_LINEAR, &FIRST_FIT_INDEXED, &FIRST_FIT_SIMD, &NEXT_FIT, &BEST_FIT, &WORST_FIT,
+    &SEGREGATED_FIT, &BUDDY
+};
+#define NUM_STRATEGIES ((int)(sizeof(STRATEGIES) / sizeof(STRATEGIES[0])))
+
+// Release the heap-backed tables owned by the memory system
+void destroy_memory(SystemMemory *sys) {
+    free_index_destroy(&sys->free_index);
+    free_index_destroy(&sys->wait_index);
+    free_array_destroy(&sys->free_array);
+    free(sys->buddy_bits);
+    free(sys->blocks);
+    free(sys->processes);
+    free(sys->process_map.entries);
+    free(sys->wait_map.entries);
+    free(sys->wait_queue);
+    free(sys->departures);
+    memset(sys, 0, sizeof(SystemMemory));
+}
+
+// Lay out the initial blocks and set every field that is not one of the metadata tables;
+// the tables are kept as they are and grown to the requested capacity
+// Returns 0 on success, -1 if the tables could not be allocated
+int setup_memory(SystemMemory *sys, int num_blocks, const kb_t block_sizes[], const MemoryConfig *config) {
+    free_index_clear(&sys->free_index);
+    free_index_clear(&sys->wait_index);
+    sys->wait_index.by_size = config->wait_policy == WAIT_SMALLEST;
+    sys->wait_policy = config->wait_policy;
+    sys->max_bypass = config->max_bypass;
+    sys->compact_on_stall = config->compact_on_stall;
+    sys->coalesce = config->coalesce;
+    sys->strategy = config->strategy;
+    sys->engine = select_engine(sys->strategy, sys->coalesce);
+    sys->use_index = sys->strategy->free_index_by_size >= 0;
+    sys->free_index.by_size = sys->strategy->free_index_by_size > 0;
+
+    // Size classes for segregated fit: the given bounds (a class starting at 1 is added
+    // if missing, so every block has a bin) or powers of two up to 2^30
+    if (config->size_classes != NULL) {
+        if (config->size_classes[0] > 1) {
+            sys->class_bounds[sys->num_classes++] = 1;
+        }
+        for (int i = 0; i < config->num_size_classes && sys->num_classes < MAX_SIZE_CLASSES; i++) {
+            sys->class_bounds[sys->num_classes++] = config->size_classes[i];
+        }
+    } else {
+        for (int k = 0; k <= 30; k++) {
+            sys->class_bounds[sys->num_classes++] = 1 << k;
+        }
+    }
+    for (int k = 0; k < MAX_SIZE_CLASSES; k++) {
+        sys->bin_heads[k] = -1;
+    }
+
+    // Allocate the tables with the requested starting capacity
+    int capacity = config->capacity;
+    if (capacity < 1) {
+        capacity = DEFAULT_CAPACITY;
+    }
+    if (ensure_capacity((void **)&sys->blocks, &sys->blocks_capacity,
+                        num_blocks > capacity ? num_blocks : capacity, sizeof(MemoryBlock)) != 0 ||
+        ensure_capacity((void **)&sys->processes, &sys->processes_capacity,
+                        capacity, sizeof(Process)) != 0 ||
+        ensure_capacity((void **)&sys->wait_queue, &sys->wait_queue_capacity,
+                        capacity, sizeof(WaitingProcess)) != 0) {
+        destroy_memory(sys);
+        return -1;
+    }
+
+    // Assign memory blocks with sequential starting addresses, linked in pool order
+    kb_t start_address = 0;
+    for (int i = 0; i < num_blocks; i++) {
+        sys->blocks[i].start = start_address;      // Set starting address
+        sys->blocks[i].size = block_sizes[i];      // Set block size
+        sys->blocks[i].is_free = 1;                // Mark block as free initially
+        sys->blocks[i].prev = i - 1;               // Link to the neighbouring blocks
+        sys->blocks[i].next = i + 1 < num_blocks ? i + 1 : -1;
+        start_address += block_sizes[i];           // Update start address for next block
+        sys->free_total += block_sizes[i];
+        note_free_block_size(sys, block_sizes[i]);
+    }
+    sys->total_memory = start_address;
+    sys->free_block_count = num_blocks;
+    sys->blocks_used = num_blocks;
+    sys->free_block_slot = -1;
+    sys->first_block = num_blocks > 0 ? 0 : -1;
+    sys->free_process_slot = -1;
+
+    sys->num_blocks = num_blocks;
+
+    // Let the strategy lay out its own initial blocks
+    if (sys->strategy->prepare != NULL && sys->strategy->prepare(sys) != 0) {
+        destroy_memory(sys);
+        return -1;
+    }
+    sys->peak_blocks = sys->num_blocks;
+
+    // Seed the strategy's free-block index with every initial block
+    if (sys->use_index && free_index_reserve(&sys->free_index, sys->num_blocks) != 0) {
+        destroy_memory(sys);
+        return -1;
+    }
+    for (int b = sys->first_block; b >= 0; b = sys->blocks[b].next) {
+        index_free_block(sys, b);
+    }
+
+    // Set initial system memory parameters
+    sys->wait_queue_front = -1;
+    sys->wait_queue_rear = -1;
+    sys->free_wait_slot = -1;
+    sys->wait_queue_count = 0;
+    return 0;
+}
+
+// Initialize the memory system with predefined memory blocks
+// Returns 0 on success, -1 if the tables could not be allocated
+int initialize_memory(SystemMemory *sys, int num_blocks, const kb_t block_sizes[], const MemoryConfig *config) {
+    // Reset the entire system memory structure to zero
+    memset(sys, 0, sizeof(SystemMemory));
+    return setup_memory(sys, num_blocks, block_sizes, config);
+}
+
+// Restart an initialized memory system with new blocks and options in bulk. The block,
+// process, wait-queue, departure, map, index and free-array tables are emptied but kept, so runs
+// after the first allocate nothing until they outgrow the earlier ones.
+// Returns 0 on success, -1 if the tables could not be grown (the system is then destroyed)
+int reset_memory(SystemMemory *sys, int num_blocks, const kb_t block_sizes[], const MemoryConfig *config) {
+    SystemMemory kept = *sys;
+    free(sys->buddy_bits);
+    memset(sys, 0, sizeof(SystemMemory));
+    sys->blocks = kept.blocks;
+    sys->blocks_capacity = kept.blocks_capacity;
+    sys->processes = kept.processes;
+    sys->processes_capacity = kept.processes_capacity;
+    sys->wait_queue = kept.wait_queue;
+    sys->wait_queue_capacity = kept.wait_queue_capacity;
+    sys->departures = kept.departures;
+    sys->departures_capacity = kept.departures_capacity;
+    sys->process_map.entries = kept.process_map.entries;
+    sys->process_map.capacity = kept.process_map.capacity;
+    sys->wait_map.entries = kept.wait_map.entries;
+    sys->wait_map.capacity = kept.wait_map.capacity;
+    if (kept.process_map.count > 0) {
+        memset(sys->process_map.entries, 0, (size_t)sys->process_map.capacity * sizeof(ProcessMapEntry));
+    }
+    if (kept.wait_map.count > 0) {
+        memset(sys->wait_map.entries, 0, (size_t)sys->wait_map.capacity * sizeof(ProcessMapEntry));
+    }
+    sys->free_index.nodes = kept.free_index.nodes;
+    sys->free_index.capacity = kept.free_index.capacity;
+    sys->wait_index.nodes = kept.wait_index.nodes;
+    sys->wait_index.capacity = kept.wait_index.capacity;
+    sys->free_array = kept.free_array;
+    sys->free_array.count = 0;
+    return setup_memory(sys, num_blocks, block_sizes, config);
+}
+
+// Length of the buddy bitmaps in bytes, as laid out by buddy_prepare()
+static inline long buddy_bitmap_bytes(const SystemMemory *sys) {
+    return (sys->buddy_offset[BUDDY_MAX_ORDER] + (long)(sys->total_memory >> BUDDY_MAX_ORDER) + 1 + 7) / 8;
+}
+
+// Bytes of simulator metadata: `reserved` is what the tables hold, which never shrinks and so
+// is also the peak; `peak_used` counts the slots handed out so far (hash tables in full)
+void metadata_footprint(const SystemMemory *sys, long *reserved, long *peak_used) {
+    long maps = ((long)sys->process_map.capacity + sys->wait_map.capacity) * (long)sizeof(ProcessMapEntry);
+    long free_array = (long)sys->free_array.capacity * (long)(2 * sizeof(kb_t) + sizeof(int));
+    long buddy = sys->buddy_bits == NULL ? 0 : buddy_bitmap_bytes(sys);
+    *reserved = (long)sys->blocks_capacity * (long)sizeof(MemoryBlock) +
+                (long)sys->processes_capacity * (long)sizeof(Process) +
+                (long)sys->wait_queue_capacity * (long)sizeof(WaitingProcess) +
+                (long)sys->departures_capacity * (long)sizeof(Departure) +
+                ((long)sys->free_index.capacity + sys->wait_index.capacity) * (long)sizeof(FreeIndexNode) +
+                maps + free_array + buddy;
+    *peak_used = (long)sys->blocks_used * (long)sizeof(MemoryBlock) +
+                 (long)sys->processes_used * (long)sizeof(Process) +
+                 (long)sys->wait_queue_used * (long)sizeof(WaitingProcess) +
+                 (long)sys->departures_peak * (long)sizeof(Departure) +
+                 ((long)sys->free_index.used + sys->wait_index.used) * (long)sizeof(FreeIndexNode) +
+                 maps + free_array + buddy;
+}
+
+// Header of a snapshot file. The SystemMemory image and its tables follow, each padded to
+// 8 bytes. A snapshot only restores into a build with the same kb_t width and FF_STATS setting.
+typedef struct {
+    char magic[8];          // SNAPSHOT_MAGIC
+    uint32_t version;       // SNAPSHOT_VERSION
+    uint32_t system_size;   // sizeof(SystemMemory) of the writing build
+    uint32_t kb_bits;       // Width of kb_t in bits
+    int32_t strategy;       // Position of the placement strategy in STRATEGIES
+    uint64_t length;        // Length of the whole file, checked on restore
+} SnapshotHeader;
+
+// Bytes a snapshot section takes in the file
+static inline size_t snapshot_padded(size_t length) {
+    return (length + 7) & ~(size_t)7;
+}
+
+// Table sections of a snapshot in file order: where each table lives in `sys`, how many bytes
+// of it are saved (the handed-out slots, or all of a hash table) and how many it holds
+static void snapshot_tables(SystemMemory *sys, void **tables[SNAPSHOT_TABLES],
+                            size_t saved[SNAPSHOT_TABLES], size_t reserved[SNAPSHOT_TABLES]) {
+    void **where[SNAPSHOT_TABLES] = {
+        (void **)&sys->blocks, (void **)&sys->processes, (void **)&sys->wait_queue,
+        (void **)&sys->process_map.entries, (void **)&sys->wait_map.entries,
+        (void **)&sys->free_index.nodes, (void **)&sys->wait_index.nodes,
+        (void **)&sys->free_array.sizes, (void **)&sys->free_array.starts,
+        (void **)&sys->free_array.blocks, (void **)&sys->buddy_bits, (void **)&sys->departures
+    };
+    size_t used[SNAPSHOT_TABLES] = {
+        (size_t)sys->blocks_used * sizeof(MemoryBlock),
+        (size_t)sys->processes_used * sizeof(Process),
+        (size_t)sys->wait_queue_used * sizeof(WaitingProcess),
+        (size_t)sys->process_map.capacity * sizeof(ProcessMapEntry),
+        (size_t)sys->wait_map.capacity * sizeof(ProcessMapEntry),
+        (size_t)sys->free_index.used * sizeof(FreeIndexNode),
+        (size_t)sys->wait_index.used * sizeof(FreeIndexNode),
+        (size_t)sys->free_array.count * sizeof(kb_t),
+        (size_t)sys->free_array.count * sizeof(kb_t),
+        (size_t)sys->free_array.count * sizeof(int),
+        sys->strategy == &BUDDY ? (size_t)buddy_bitmap_bytes(sys) : 0,
+        (size_t)sys->departure_count * sizeof(Departure)
+    };
+    size_t held[SNAPSHOT_TABLES] = {
+        (size_t)sys->blocks_capacity * sizeof(MemoryBlock),
+        (size_t)sys->processes_capacity * sizeof(Process),
+        (size_t)sys->wait_queue_capacity * sizeof(WaitingProcess),
+        used[3], used[4],
+        (size_t)sys->free_index.capacity * sizeof(FreeIndexNode),
+        (size_t)sys->wait_index.capacity * sizeof(FreeIndexNode),
+        (size_t)sys->free_array.capacity * sizeof(kb_t),
+        (size_t)sys->free_array.capacity * sizeof(kb_t),
+        (size_t)sys->free_array.capacity * sizeof(int),
+        used[10],
+        (size_t)sys->departures_capacity * sizeof(Departure)
+    };
+    memcpy(tables, where, sizeof(where));
+    memcpy(saved, used, sizeof(used));
+    memcpy(reserved, held, sizeof(held));
+}
+
+// Write one section of a snapshot followed by its padding
+// Returns 0 on success, -1 if writing failed
+static int snapshot_write(FILE *out, const void *data, size_t length) {
+    static const char padding[8];
+    size_t pad = snapshot_padded(length) - length;
+    return (length == 0 || fwrite(data, length, 1, out) == 1) &&
+           (pad == 0 || fwrite(padding, pad, 1, out) == 1) ? 0 : -1;
+}
+
+// Save the whole memory system to `path` in bulk: the header, the SystemMemory image and
+// every table written in one piece
+// Returns 0 on success, -1 if the file could not be written
+int save_snapshot(const SystemMemory *sys, const char *path) {
+    SystemMemory image = *sys;
+    void **tables[SNAPSHOT_TABLES];
+    size_t saved[SNAPSHOT_TABLES], reserved[SNAPSHOT_TABLES];
+    snapshot_tables(&image, tables, saved, reserved);
+
+    // The image's pointers are meaningless in another process; the strategy is saved by number
+    SnapshotHeader header = {SNAPSHOT_MAGIC, SNAPSHOT_VERSION, sizeof(SystemMemory), 8 * sizeof(kb_t), 0,
+                             sizeof(SnapshotHeader) + snapshot_padded(sizeof(SystemMemory))};
+    while (header.strategy < NUM_STRATEGIES && STRATEGIES[header.strategy] != sys->strategy) {
+        header.strategy++;
+    }
+    const void *data[SNAPSHOT_TABLES];
+    for (int t = 0; t < SNAPSHOT_TABLES; t++) {
+        data[t] = *tables[t];
+        *tables[t] = NULL;
+        header.length += snapshot_padded(saved[t]);
+    }
+    image.strategy = NULL;
+    image.engine = NULL;
+
+    FILE *out = fopen(path, "wb");
+    if (out == NULL) {
+        perror(path);
+        return -1;
+    }
+    int failed = snapshot_write(out, &header, sizeof(header)) != 0 ||
+                 snapshot_write(out, &image, sizeof(image)) != 0;
+    for (int t = 0; t < SNAPSHOT_TABLES && !failed; t++) {
+        failed = snapshot_write(out, data[t], saved[t]) != 0;
+    }
+    failed |= fclose(out) != 0;
+    if (failed) {
+        fprintf(stderr, "Could not write snapshot %s\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+// Restore a memory system saved by save_snapshot(). The file is mapped read-only and each
+// table is copied out of the mapping in one piece into storage of its saved capacity, so
+// the restored system grows and places exactly as the saved one would have.
+// Returns 0 on success, -1 if the file is not a snapshot of this build or tables could not be allocated
+int restore_snapshot(SystemMemory *sys, const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        perror(path);
+        return -1;
+    }
+    struct stat st;
+    size_t start = sizeof(SnapshotHeader) + snapshot_padded(sizeof(SystemMemory));
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (size_t)st.st_size < start) {
+        fprintf(stderr, "%s: not a snapshot file\n", path);
+        close(fd);
+        return -1;
+    }
+    size_t length = (size_t)st.st_size;
+    void *map = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        perror(path);
+        return -1;
+    }
+    posix_madvise(map, length, POSIX_MADV_SEQUENTIAL);
+
+    const SnapshotHeader *header = map;
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != SNAPSHOT_VERSION || header->system_size != sizeof(SystemMemory) ||
+        header->kb_bits != 8 * sizeof(kb_t) || header->length != length ||
+        header->strategy < 0 || header->strategy >= NUM_STRATEGIES) {
+        fprintf(stderr, "%s: not a snapshot of this simulator build (version, kb_t width or FF_STATS "
+                "differ) or truncated\n", path);
+        munmap(map, length);
+        return -1;
+    }
+    memcpy(sys, header + 1, sizeof(SystemMemory));
+    sys->strategy = STRATEGIES[header->strategy];
+    sys->engine = select_engine(sys->strategy, sys->coalesce);
+
+    // Check the sections against the file before allocating anything
+    void **tables[SNAPSHOT_TABLES];
+    size_t saved[SNAPSHOT_TABLES], reserved[SNAPSHOT_TABLES];
+    snapshot_tables(sys, tables, saved, reserved);
+    size_t offset = start;
+    int valid = 1;
+    for (int t = 0; t < SNAPSHOT_TABLES; t++) {
+        *tables[t] = NULL;
+        valid &= saved[t] <= reserved[t];
+        offset += snapshot_padded(saved[t]);
+    }
+    if (!valid || offset != length) {
+        fprintf(stderr, "%s: inconsistent snapshot tables\n", path);
+        memset(sys, 0, sizeof(SystemMemory));
+        munmap(map, length);
+        return -1;
+    }
+
+    offset = start;
+    for (int t = 0; t < SNAPSHOT_TABLES; t++) {
+        if (reserved[t] > 0) {
+            *tables[t] = malloc(reserved[t]);
+            if (*tables[t] == NULL) {
+                fprintf(stderr, "Could not allocate simulator tables\n");
+                destroy_memory(sys);
+                munmap(map, length);
+                return -1;
+            }
+            memcpy(*tables[t], (const char *)map + offset, saved[t]);
+        }
+        offset += snapshot_padded(saved[t]);
+    }
+    munmap(map, length);
+    return 0;
+}
+
+// Total amount of free memory in the system, maintained on every allocate, free and merge
+kb_t get_total_free_memory(SystemMemory *sys) {
+    return sys->free_total;
+}
+
+// Number of free blocks in the system, maintained on every split, free and merge
+int get_free_block_count(SystemMemory *sys) {
+    return sys->free_block_count;
+}
+
+// Size of the largest free block
+// With the free-block index this is the root's subtree maximum. Without it the running
+// maximum is exact until the largest block is allocated, after which the next read
+// rescans once to find the new maximum.
+kb_t get_largest_free_block(SystemMemory *sys) {
+    if (sys->use_index) {
+        return free_index_max(&sys->free_index, sys->free_index.root);
+    }
+    if (sys->largest_stale) {
+        sys->largest_free = 0;
+        for (int b = sys->first_block; b >= 0; b = sys->blocks[b].next) {
+            if (sys->blocks[b].is_free) {
+                note_free_block_size(sys, sys->blocks[b].size);
+            }
+        }
+        sys->largest_stale = 0;
+    }
+    return sys->largest_free;
+}
+
+// External fragmentation: the share of free memory outside the largest free block
+double external_fragmentation(SystemMemory *sys) {
+    kb_t free_total = get_total_free_memory(sys);
+    return free_total > 0 ? 1.0 - (double)get_largest_free_block(sys) / free_total : 0.0;
+}
+
+// Size under which a waiter is kept in the wait index. Ordered by arrival, the index stores
+// the complement of the block size, so a fit query for the complement of the largest free
+// block finds the oldest waiter that fits. Smallest-first orders by (block size, arrival).
+static inline kb_t wait_index_size(const SystemMemory *sys, const WaitingProcess *waiter) {
+    return sys->wait_policy == WAIT_SMALLEST ? waiter->block_size : KB_MAX - waiter->block_size;
+}
+
+// Add a process to the waiting queue when immediate memory allocation is not possible
+int add_to_wait_queue(SystemMemory *sys, int process_id, kb_t size) {
+    // Take a recycled slot, or grow the pool (and the wait index) when it is full
+    int slot = sys->free_wait_slot;
+    if ((slot < 0 && ensure_capacity((void **)&sys->wait_queue, &sys->wait_queue_capacity,
+                                     sys->wait_queue_used + 1, sizeof(WaitingProcess)) != 0) ||
+        process_map_reserve(&sys->wait_map) != 0 ||
+        (sys->wait_policy != WAIT_FIFO && free_index_reserve(&sys->wait_index, 1) != 0)) {
+        if (sys->verbose) {
+            printf("Wait queue is full. Cannot add process %d\n", process_id);
+        }
+        return 0;
+    }
+    if (slot >= 0) {
+        sys->free_wait_slot = sys->wait_queue[slot].next;
+    } else {
+        slot = sys->wait_queue_used++;
+    }
+
+    // Append the process in arrival order
+    WaitingProcess *waiter = &sys->wait_queue[slot];
+    waiter->process_id = process_id;
+    waiter->memory_size = size;
+    waiter->block_size = sys->strategy->block_size != NULL ? sys->strategy->block_size(sys, size) : size;
+    waiter->seq = sys->wait_seq++;
+    waiter->bypassed = 0;
+    waiter->enqueued_at = sys->clock;
+    waiter->duration = 0;
+    waiter->prev = sys->wait_queue_rear;
+    waiter->next = -1;
+    if (sys->wait_queue_rear >= 0) {
+        sys->wait_queue[sys->wait_queue_rear].next = slot;
+    } else {
+        sys->wait_queue_front = slot;
+    }
+    sys->wait_queue_rear = slot;
+    sys->wait_queue_count++;
+    process_map_insert(&sys->wait_map, process_id, slot);
+    STAT_INC(sys->stats.enqueues);
+    if (sys->wait_policy != WAIT_FIFO) {
+        free_index_insert(&sys->wait_index, waiter->seq, wait_index_size(sys, waiter), slot);
+    }
+
+    if (sys->verbose) {
+        printf("Process %d added to wait queue due to insufficient memory\n", process_id);
+    }
+    return 1;
+}
+
+// Unlink a waiter from the queue and the wait index, recycling its slot
+void remove_waiter(SystemMemory *sys, int slot) {
+    WaitingProcess *waiter = &sys->wait_queue[slot];
+    if (waiter->prev >= 0) {
+        sys->wait_queue[waiter->prev].next = waiter->next;
+    } else {
+        sys->wait_queue_front = waiter->next;
+    }
+    if (waiter->next >= 0) {
+        sys->wait_queue[waiter->next].prev = waiter->prev;
+    } else {
+        sys->wait_queue_rear = waiter->prev;
+    }
+    if (sys->wait_policy != WAIT_FIFO) {
+        free_index_remove(&sys->wait_index, waiter->seq, wait_index_size(sys, waiter));
+    }
+    process_map_remove(&sys->wait_map, waiter->process_id);
+    STAT_INC(sys->stats.dequeues);
+    waiter->next = sys->free_wait_slot;
+    sys->free_wait_slot = slot;
+    sys->wait_queue_count--;
+}
+
+// Schedule the departure of placed process `process_id` `duration` after the current time
+// Returns 0 on success, -1 if the departure heap could not grow (the process then runs until freed)
+int schedule_departure(SystemMemory *sys, int process_id, long duration) {
+    int slot = process_map_find(&sys->process_map, process_id);
+    if (slot < 0 || ensure_capacity((void **)&sys->departures, &sys->departures_capacity,
+                                    sys->departure_count + 1, sizeof(Departure)) != 0) {
+        if (sys->verbose && slot >= 0) {
+            printf("Out of simulator memory. Process %d runs until freed\n", process_id);
+        }
+        return -1;
+    }
+    long time = sys->clock + duration;
+    sys->processes[slot].departs_at = time;
+
+    // Sift the new departure up to its place in the heap
+    Departure *heap = sys->departures;
+    int i = sys->departure_count++;
+    if (sys->departure_count > sys->departures_peak) {
+        sys->departures_peak = sys->departure_count;
+    }
+    while (i > 0 && heap[(i - 1) / 2].time > time) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i].time = time;
+    heap[i].process_id = process_id;
+    return 0;
+}
+
+// Remove the earliest departure from the heap
+static void pop_departure(SystemMemory *sys) {
+    Departure *heap = sys->departures;
+    Departure last = heap[--sys->departure_count];
+    int i = 0;
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= sys->departure_count) {
+            break;
+        }
+        if (child + 1 < sys->departure_count && heap[child + 1].time < heap[child].time) {
+            child++;
+        }
+        if (heap[child].time >= last.time) {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+}
+
+// Run every departure due at or before `time` in time order. The clock stops at each one,
+// so waiters its free serves are timed from the moment memory was released. Departures of
+// processes freed by hand (or placed again since) are dropped.
+// Returns the number of processes that departed
+int run_departures(SystemMemory *sys, long time) {
+    int departed = 0;
+    while (sys->departure_count > 0 && sys->departures[0].time <= time) {
+        Departure next = sys->departures[0];
+        pop_departure(sys);
+        int slot = process_map_find(&sys->process_map, next.process_id);
+        if (slot >= 0 && sys->processes[slot].departs_at == next.time) {
+            if (next.time > sys->clock) {
+                sys->clock = next.time;
+            }
+            if (sys->verbose) {
+                printf("Process %d departed at time %ld\n", next.process_id, next.time);
+            }
+            free_memory(sys, next.process_id);
+            departed++;
+        }
+    }
+    sys->departed += departed;
+    return departed;
+}
+
+// Move simulated time to `time`, first running the departures due by then
+static inline void set_clock(SystemMemory *sys, long time) {
+    if (sys->departure_count > 0) {
+        run_departures(sys, time);
+    }
+    sys->clock = time;
+}
+
+// Pick the waiter the wait policy serves next; first-fit searches only consider waiters
+// that arrived at or after `from`. Returns its slot, or -1 if the policy lets none through
+int pick_waiter(SystemMemory *sys, int from) {
+    int head = sys->wait_queue_front;
+    kb_t largest = sys->wait_policy == WAIT_FIFO ? 0 : get_largest_free_block(sys);
+    switch (sys->wait_policy) {
+        case WAIT_FIFO:
+            // Only the head, once total free memory covers it
+            return get_total_free_memory(sys) >= sys->wait_queue[head].memory_size ? head : -1;
+        case WAIT_FIRST_FIT:
+            return free_index_first_fit_from(&sys->wait_index, sys->wait_index.root,
+                                             KB_MAX - largest, from);
+        case WAIT_SMALLEST: {
+            int smallest = free_index_best_fit(&sys->wait_index, 0);
+            return sys->wait_queue[smallest].block_size <= largest ? smallest : -1;
+        }
+        case WAIT_BYPASS:
+            // The head goes first if it fits; others may pass it until it has aged out
+            if (sys->wait_queue[head].block_size <= largest) {
+                return head;
+            }
+            if (sys->wait_queue[head].bypassed >= sys->max_bypass) {
+                return -1;
+            }
+            return free_index_first_fit_from(&sys->wait_index, sys->wait_index.root,
+                                             KB_MAX - largest, from);
+    }
+    return -1;
+}
+
+// Serve waiting processes after memory was released, in a single pass over the eligible
+// waiters. Allocations only shrink the largest free block, so a waiter that did not fit
+// earlier in the pass cannot fit later and first-fit searches resume after the last one
+// served. Returns the number of waiters allocated memory
+int drain_wait_queue(SystemMemory *sys) {
+    int served = 0;
+    int from = 0;        // Arrival number to resume first-fit searches from
+    int coalesced = 0;   // Whether this pass already merged pending free runs
+    int compacted = 0;   // Whether this pass already compacted memory
+    STAT_TIMER_START(start);
+    STAT_INC(sys->stats.drains);
+
+    while (sys->wait_queue_count > 0) {
+        STAT_INC(sys->stats.drain_iterations);
+        // Choose a waiter; under deferred coalescing, merge pending free runs once and
+        // restart the search, since merging can grow the largest free block
+        int head = sys->wait_queue_front;
+        int slot = pick_waiter(sys, from);
+        if (slot < 0 && !coalesced && sys->wait_policy != WAIT_FIFO &&
+            sys->coalesce == COALESCE_DEFERRED && sys->pending_coalesce > 0 &&
+            sys->strategy->coalesce == NULL) {
+            coalesce_all(sys);
+            coalesced = 1;
+            from = 0;
+            slot = pick_waiter(sys, from);
+        }
+        if (slot >= 0) {
+            WaitingProcess waiter = sys->wait_queue[slot];
+            from = waiter.seq + 1;
+
+            // Place the waiter without re-queueing it if placement fails
+            if (place_process(sys, waiter.process_id, waiter.memory_size) != -1) {
+                if (slot != head) {
+                    sys->wait_queue[head].bypassed++;
+                    sys->bypasses++;
+                }
+                remove_waiter(sys, slot);
+                histogram_record(&sys->wait_times, sys->clock - waiter.enqueued_at);
+                if (waiter.duration > 0) {
+                    schedule_departure(sys, waiter.process_id, waiter.duration);
+                }
+                served++;
+                if (compacted) {
+                    sys->compaction_served++;
+                }
+                if (sys->verbose) {
+                    printf("Process %d moved from waiting queue and allocated memory\n",
+                           waiter.process_id);
+                }
+                continue;
+            }
+        }
+
+        // The queue is stalled on fragmentation when the head would fit in the total free
+        // space but not in any free block; compact once and look again
+        kb_t need = sys->wait_queue[head].block_size;
+        if (sys->compact_on_stall && !compacted && need <= get_total_free_memory(sys) &&
+            need > get_largest_free_block(sys) && compact_memory(sys) == 0) {
+            compacted = 1;
+            from = 0;
+            continue;
+        }
+        break; // No remaining waiter can be served yet
+    }
+    STAT_TIMER_STOP(sys->stats.drain_ns, start);
+    return served;
+}
+
+// Serve the wait queue after memory was released: now, or once at the end of the current batch
+static inline void schedule_drain(SystemMemory *sys) {
+    if (sys->in_batch) {
+        sys->drain_pending = 1;
+    } else {
+        drain_wait_queue(sys);
+    }
+}
+
+// Start a batch of operations. Frees in the batch release their memory (and merge it under
+// the coalescing policy) but leave the wait queue to end_batch(), which drains it once for
+// all of them instead of once per free. Allocations never drain, so they are unchanged.
+void begin_batch(SystemMemory *sys) {
+    sys->in_batch = 1;
+}
+
+// Finish a batch, draining the wait queue once if any of its frees released memory
+// Returns the number of waiters served
+int end_batch(SystemMemory *sys) {
+    sys->in_batch = 0;
+    int served = sys->drain_pending ? drain_wait_queue(sys) : 0;
+    sys->drain_pending = 0;
+    return served;
+}
+
+// Place a process with `strategy` under `coalesce`, without queueing it on failure. Engine
+// variants pass both as constants, so their function pointers fold into direct calls.
+// Returns the start address, or -1 if no free block fits
+ENGINE_INLINE kb_t place_process_as(SystemMemory *sys, int process_id, kb_t size,
+                                    const PlacementStrategy *strategy, CoalescePolicy coalesce) {
+    // A process id can only own one allocation at a time
+    if (process_map_find(&sys->process_map, process_id) >= 0) {
+        if (sys->verbose) {
+            printf("Process %d already has memory allocated\n", process_id);
+        }
+        return -1;
+    }
+
+    // Make room for the split blocks and the new process record up front
+    if (reserve_block_nodes(sys, strategy->carve != NULL ? BUDDY_MAX_ORDER : 1) != 0 ||
+        ensure_capacity((void **)&sys->processes, &sys->processes_capacity,
+                        sys->processes_used + 1, sizeof(Process)) != 0 ||
+        process_map_reserve(&sys->process_map) != 0 ||
+        (strategy->free_index_by_size >= 0 && free_index_reserve(&sys->free_index, 1) != 0)) {
+        if (sys->verbose) {
+            printf("Out of simulator memory. Cannot allocate process %d\n", process_id);
+        }
+        return -1;
+    }
+
+    // Some strategies carve a larger block than requested (rounded to a size class)
+    kb_t block_size = strategy->block_size != NULL ? strategy->block_size(sys, size) : size;
+#ifdef FF_STATS
+    long scanned = sys->stats.blocks_scanned + sys->free_index.visits;
+#endif
+    int b = strategy->find_block(sys, block_size);
+
+    // Under deferred coalescing, merge pending free runs once and look again
+    if (b < 0 && coalesce == COALESCE_DEFERRED && sys->pending_coalesce > 0 &&
+        strategy->coalesce == NULL) {
+        coalesce_all(sys);
+        b = strategy->find_block(sys, block_size);
+    }
+#ifdef FF_STATS
+    histogram_record(&sys->stats.scan_lengths, sys->stats.blocks_scanned + sys->free_index.visits - scanned);
+#endif
+
+    if (b >= 0) {
+        // The chosen block leaves the free index; any split remainder re-enters it below
+        unindex_free_block_as(sys, strategy, b);
+        if (sys->blocks[b].size == sys->largest_free) {
+            sys->largest_stale = 1;
+        }
+        sys->free_block_count--;
+
+        // Split the block if it's larger than required; the remainder stays free
+        if (strategy->carve != NULL) {
+            strategy->carve(sys, b, block_size);
+        } else if (sys->blocks[b].size > block_size) {
+            split_free_remainder_as(sys, strategy, b, block_size);
+        }
+        sys->blocks[b].is_free = 0;
+        sys->free_total -= block_size;
+        sys->internal_fragmentation += block_size - size;
+        if (strategy->on_allocate != NULL) {
+            strategy->on_allocate(sys, b, block_size);
+        }
+
+        // Record the process in active processes list
+        int slot = new_process_slot(sys);
+        sys->processes[slot].id = process_id;
+        sys->processes[slot].memory_address = sys->blocks[b].start;
+        sys->processes[slot].memory_size = size;
+        sys->processes[slot].is_active = 1;
+        sys->processes[slot].block = b;
+        sys->processes[slot].departs_at = 0;
+        process_map_insert(&sys->process_map, process_id, slot);
+        sys->num_processes++;
+
+        return sys->blocks[b].start;
+    }
+    return -1;
+}
+
+// Generic engine: strategy and coalescing policy are read from the memory system
+kb_t place_process_generic(SystemMemory *sys, int process_id, kb_t size) {
+    return place_process_as(sys, process_id, size, sys->strategy, sys->coalesce);
+}
+
+// Place a process with the configured placement strategy, without queueing it on failure
+// Returns the start address, or -1 if no free block fits
+kb_t place_process(SystemMemory *sys, int process_id, kb_t size) {
+    return sys->engine->place(sys, process_id, size);
+}
+
+// Allocate memory for a process, adding it to the wait queue if no free block fits
+// Returns the start address, or -1 if the process could not be placed
+kb_t allocate_memory(SystemMemory *sys, int process_id, kb_t size) {
+    STAT_TIMER_START(start);
+    kb_t address = -1;
+
+    // A waiting process already has a request queued
+    if (process_map_find(&sys->wait_map, process_id) >= 0) {
+        if (sys->verbose) {
+            printf("Process %d is already waiting for memory\n", process_id);
+        }
+    } else {
+        address = place_process(sys, process_id, size);
+        if (address == -1 && process_map_find(&sys->process_map, process_id) < 0) {
+            add_to_wait_queue(sys, process_id, size);
+        }
+    }
+    STAT_TIMER_STOP(sys->stats.allocate_ns, start);
+    return address;
+}
+
+// Allocate memory for a process that runs for `duration` of simulated time once placed, after
+// which its departure frees the memory; a process that has to wait starts running when the
+// wait queue serves it. A `duration` of 0 runs until freed, as with allocate_memory().
+// Returns the start address, or -1 if the process could not be placed
+kb_t allocate_for(SystemMemory *sys, int process_id, kb_t size, long duration) {
+    int waiting = sys->wait_queue_count;
+    kb_t address = allocate_memory(sys, process_id, size);
+    if (duration > 0) {
+        if (address != -1) {
+            schedule_departure(sys, process_id, duration);
+        } else if (sys->wait_queue_count > waiting) {
+            sys->wait_queue[sys->wait_queue_rear].duration = duration;
+        }
+    }
+    return address;
+}
+
+// Release the memory of a process (or withdraw its wait) with `strategy` under `coalesce`,
+// then serve the wait queue
+// Returns 1 if the process was found, 0 otherwise
+ENGINE_INLINE int release_process_as(SystemMemory *sys, int process_id, const PlacementStrategy *strategy,
+                                     CoalescePolicy coalesce) {
+    // Reserve an index node up front so the freed block can always be recorded
+    if (strategy->free_index_by_size >= 0 && free_index_reserve(&sys->free_index, 1) != 0) {
+        if (sys->verbose) {
+            printf("Out of simulator memory. Cannot free process %d\n", process_id);
+        }
+        return 0;
+    }
+
+    // Look up the process and its block in O(1)
+    int slot = process_map_find(&sys->process_map, process_id);
+    if (slot < 0) {
+        // A process that ends while waiting withdraws its request
+        int waiting = process_map_find(&sys->wait_map, process_id);
+        if (waiting >= 0) {
+            remove_waiter(sys, waiting);
+            sys->withdrawn++;
+            if (sys->verbose) {
+                printf("Process %d removed from wait queue\n", process_id);
+            }
+            return 1;
+        }
+        if (sys->verbose) {
+            printf("Process %d not found\n", process_id);
+        }
+        return 0;
+    }
+
+    // Mark the process as inactive and recycle its record
+    int block = sys->processes[slot].block;
+    sys->internal_fragmentation -= sys->blocks[block].size - sys->processes[slot].memory_size;
+    process_map_remove(&sys->process_map, process_id);
+    release_process_slot(sys, slot);
+    sys->num_processes--;
+
+    // Free the corresponding memory block
+    sys->blocks[block].is_free = 1;
+    sys->free_total += sys->blocks[block].size;
+    sys->free_block_count++;
+
+    // Merge with free neighbours according to the coalescing policy; strategies with
+    // their own merge rule (buddy) apply it on every free unless coalescing is off
+    if (strategy->coalesce != NULL) {
+        if (coalesce != COALESCE_NEVER) {
+            block = strategy->coalesce(sys, block);
+        }
+    } else if (coalesce == COALESCE_IMMEDIATE) {
+        block = coalesce_block_as(sys, strategy, block);
+    } else if (coalesce == COALESCE_DEFERRED) {
+        sys->pending_coalesce++;
+    }
+    note_free_block_size(sys, sys->blocks[block].size);
+    index_free_block_as(sys, strategy, block);
+    if (sys->verbose) {
+        printf("Memory for Process %d freed\n", process_id);
+    }
+
+    // Attempt to allocate memory for waiting processes
+    schedule_drain(sys);
+    return 1;
+}
+
+// Generic engine: strategy and coalescing policy are read from the memory system
+int release_process_generic(SystemMemory *sys, int process_id) {
+    return release_process_as(sys, process_id, sys->strategy, sys->coalesce);
+}
+
+const EngineVariant GENERIC_ENGINE = {"generic", NULL, COALESCE_IMMEDIATE, place_process_generic,
+                                      release_process_generic};
+
+#ifndef FF_GENERIC
+// Every strategy under every coalescing policy, as (strategy, policy, variant name, suffix)
+#define FOR_EACH_ENGINE_STRATEGY(X, coalesce, policy) \
+    X(FIRST_FIT_LINEAR, coalesce, "first-fit-linear/" #policy, first_fit_linear_##policy) \
+    X(FIRST_FIT_INDEXED, coalesce, "first-fit-tree/" #policy, first_fit_tree_##policy) \
+    X(FIRST_FIT_SIMD, coalesce, "first-fit-simd/" #policy, first_fit_simd_##policy) \
+    X(NEXT_FIT, coalesce, "next-fit/" #policy, next_fit_##policy) \
+    X(BEST_FIT, coalesce, "best-fit/" #policy, best_fit_##policy) \
+    X(WORST_FIT, coalesce, "worst-fit/" #policy, worst_fit_##policy) \
+    X(SEGREGATED_FIT, coalesce, "segregated/" #policy, segregated_##policy) \
+    X(BUDDY, coalesce, "buddy/" #policy, buddy_##policy)
+#define FOR_EACH_ENGINE(X) \
+    FOR_EACH_ENGINE_STRATEGY(X, COALESCE_IMMEDIATE, immediate) \
+    FOR_EACH_ENGINE_STRATEGY(X, COALESCE_DEFERRED, deferred) \
+    FOR_EACH_ENGINE_STRATEGY(X, COALESCE_NEVER, never)
+
+// Specialized engine variants: the shared bodies instantiated with constant arguments, so
+// each is a loop without strategy dispatch or policy branches
+#define DEFINE_ENGINE_VARIANT(strategy, coalesce, name, suffix) \
+    static kb_t place_##suffix(SystemMemory *sys, int process_id, kb_t size) { \
+        return place_process_as(sys, process_id, size, &strategy, coalesce); \
+    } \
+    static int release_##suffix(SystemMemory *sys, int process_id) { \
+        return release_process_as(sys, process_id, &strategy, coalesce); \
+    }
+#define ENGINE_VARIANT_ENTRY(strategy, coalesce, name, suffix) \
+    {name, &strategy, coalesce, place_##suffix, release_##suffix},
+
+FOR_EACH_ENGINE(DEFINE_ENGINE_VARIANT)
+
+const EngineVariant ENGINE_VARIANTS[] = {
+    FOR_EACH_ENGINE(ENGINE_VARIANT_ENTRY)
+};
+#endif
+
+// Pick the engine variant specialized for a strategy and coalescing policy at startup, or
+// the generic engine in FF_GENERIC builds
+const EngineVariant *select_engine(const PlacementStrategy *strategy, CoalescePolicy coalesce) {
+#ifndef FF_GENERIC
+    for (size_t i = 0; i < sizeof(ENGINE_VARIANTS) / sizeof(ENGINE_VARIANTS[0]); i++) {
+        if (ENGINE_VARIANTS[i].strategy == strategy && ENGINE_VARIANTS[i].coalesce == coalesce) {
+            return &ENGINE_VARIANTS[i];
+        }
+    }
+#else
+    (void)strategy;
+    (void)coalesce;
+#endif
+    return &GENERIC_ENGINE;
+}
+
+// Release the memory of a process (or withdraw its wait) and serve the wait queue
+// Returns 1 if the process was found, 0 otherwise
+int release_process(SystemMemory *sys, int process_id) {
+    return sys->engine->release(sys, process_id);
+}
+
+// Free memory allocated to a specific process
+// Returns 1 if the process was found and its memory released (or its wait withdrawn), 0 otherwise
+int free_memory(SystemMemory *sys, int process_id) {
+    STAT_TIMER_START(start);
+    int found = release_process(sys, process_id);
+    STAT_TIMER_STOP(sys->stats.free_ns, start);
+    return found;
+}
+
+// Free `count` processes as one batch, serving the wait queue once at the end
+// Returns the number of processes found
+int free_memory_batch(SystemMemory *sys, const int *process_ids, int count) {
+    int found = 0;
+    int nested = sys->in_batch;
+    begin_batch(sys);
+    for (int i = 0; i < count; i++) {
+        found += free_memory(sys, process_ids[i]);
+    }
+    if (!nested) {
+        end_batch(sys);
+    }
+    return found;
+}
+
+// Text gathered for one write to stdout
+typedef struct {
+    char *data;     // Buffered text (not NUL-terminated past `length`)
+    int length;     // Bytes buffered
+    int capacity;   // Bytes allocated
+} OutputBuffer;
+
+// Append formatted text to an output buffer; text that cannot be buffered is dropped
+void buffer_printf(OutputBuffer *out, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int needed = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+    if (needed < 0 || ensure_capacity((void **)&out->data, &out->capacity, out->length + needed + 1, 1) != 0) {
+        return;
+    }
+    va_start(args, format);
+    vsnprintf(out->data + out->length, (size_t)needed + 1, format, args);
+    va_end(args);
+    out->length += needed;
+}
+
+// Write the buffered text to stdout in one call and empty the buffer
+void buffer_flush(OutputBuffer *out) {
+    fwrite(out->data, 1, (size_t)out->length, stdout);
+    fflush(stdout);
+    out->length = 0;
+}
+
+// Print a summary of the memory layout: counts, the largest free blocks and a run-length
+// map of allocated and free regions, capped at LAYOUT_MAP_RUNS runs so that its size does
+// not grow with the block count. The full listing is print_full_layout().
+void print_memory_layout(SystemMemory *sys, OutputBuffer *out) {
+    kb_t top[LAYOUT_TOP_FREE];
+    kb_t top_start[LAYOUT_TOP_FREE];
+    int num_top = 0, free_blocks = 0, runs = 0;
+    kb_t free_total = 0;
+    int run_blocks = 0, run_free = 0;
+    kb_t run_start = 0, run_size = 0;
+
+    buffer_printf(out, "Memory Map:\n");
+    for (int b = sys->first_block; b >= 0; b = sys->blocks[b].next) {
+        const MemoryBlock *block = &sys->blocks[b];
+        if (block->is_free) {
+            free_blocks++;
+            free_total += block->size;
+
+            // Keep the largest free blocks in descending order, lowest address on ties
+            int slot = num_top < LAYOUT_TOP_FREE ? num_top++ : LAYOUT_TOP_FREE;
+            while (slot > 0 && top[slot - 1] < block->size) {
+                if (slot < LAYOUT_TOP_FREE) {
+                    top[slot] = top[slot - 1];
+                    top_start[slot] = top_start[slot - 1];
+                }
+                slot--;
+            }
+            if (slot < LAYOUT_TOP_FREE) {
+                top[slot] = block->size;
+                top_start[slot] = block->start;
+            }
+        }
+
+        // Close the current run when the block changes state
+        if (run_blocks > 0 && block->is_free != run_free) {
+            if (runs++ < LAYOUT_MAP_RUNS) {
+                buffer_printf(out, "  %" PRIkb "-%" PRIkb "KB: %s, %" PRIkb "KB in %d block%s\n", run_start,
+                              run_start + run_size - 1, run_free ? "Free" : "Allocated", run_size, run_blocks,
+                              run_blocks == 1 ? "" : "s");
+            }
+            run_blocks = 0;
+        }
+        if (run_blocks == 0) {
+            run_start = block->start;
+            run_size = 0;
+            run_free = block->is_free;
+        }
+        run_size += block->size;
+        run_blocks++;
+    }
+    if (run_blocks > 0 && runs++ < LAYOUT_MAP_RUNS) {
+        buffer_printf(out, "  %" PRIkb "-%" PRIkb "KB: %s, %" PRIkb "KB in %d block%s\n", run_start,
+                      run_start + run_size - 1, run_free ? "Free" : "Allocated", run_size, run_blocks,
+                      run_blocks == 1 ? "" : "s");
+    }
+    if (runs > LAYOUT_MAP_RUNS) {
+        buffer_printf(out, "  ... %d more runs (choose Show Full Layout to list every block)\n",
+                      runs - LAYOUT_MAP_RUNS);
+    }
+
+    buffer_printf(out, "\nSummary: %d blocks (%d free), %" PRIkb "KB of %" PRIkb "KB free, %d active, "
+                  "%d waiting\n", sys->num_blocks, free_blocks, free_total, sys->total_memory,
+                  sys->num_processes, sys->wait_queue_count);
+    buffer_printf(out, "Largest free blocks:");
+    if (num_top == 0) {
+        buffer_printf(out, " none");
+    }
+    for (int i = 0; i < num_top; i++) {
+        buffer_printf(out, "%s %" PRIkb "KB at %" PRIkb, i > 0 ? "," : "", top[i], top_start[i]);
+    }
+    if (sys->wait_queue_count > 0) {
+        const WaitingProcess *head = &sys->wait_queue[sys->wait_queue_front];
+        buffer_printf(out, "\nOldest waiter: process %d for %" PRIkb "KB", head->process_id, head->memory_size);
+    }
+    buffer_printf(out, "\n\n---------------------------------------------\n\n");
+    buffer_flush(out);
+}
+
+// Add one row to the full layout dump, pausing after every LAYOUT_PAGE_ROWS rows
+// Returns 0 to go on, or -1 once the user has stopped the listing
+int page_row(OutputBuffer *out, int *rows) {
+    if (++*rows % LAYOUT_PAGE_ROWS != 0) {
+        return 0;
+    }
+    buffer_printf(out, "-- %d rows shown; press Enter for more or q to stop: ", *rows);
+    buffer_flush(out);
+    char answer[16];
+    return fgets(answer, sizeof(answer), stdin) == NULL || answer[0] == 'q' ? -1 : 0;
+}
+
+// Print every block, active process and waiter, one page of rows at a time
+void print_full_layout(SystemMemory *sys, OutputBuffer *out) {
+    int rows = 0;
+    buffer_printf(out, "Memory Blocks:\n");
+    int number = 1;
+    for (int b = sys->first_block; b >= 0; b = sys->blocks[b].next) {
+        buffer_printf(out, "Block %d: Start_address=%" PRIkb ", Size=%" PRIkb "KB, %s\n",
+                      number++,
+                      sys->blocks[b].start,
+                      sys->blocks[b].size,
+                      sys->blocks[b].is_free ? "Free" : "Allocated");
+        if (page_row(out, &rows) != 0) {
+            return;
+        }
+    }
+
+    // Display active processes
+    buffer_printf(out, "\nActive Processes:\n");
+    if (sys->num_processes == 0) {
+        buffer_printf(out, "No active processes\n");
+    }
+    for (int i = 0; i < sys->processes_used; i++) {
+        if (sys->processes[i].is_active) {
+            buffer_printf(out, "Process %d: Address=%" PRIkb ", Size=%" PRIkb "KB",
+                          sys->processes[i].id,
+                          sys->processes[i].memory_address,
+                          sys->processes[i].memory_size);
+            if (sys->processes[i].departs_at > 0) {
+                buffer_printf(out, ", departs at time %ld", sys->processes[i].departs_at);
+            }
+            buffer_printf(out, "\n");
+            if (page_row(out, &rows) != 0) {
+                return;
+            }
+        }
+    }
+
+    // Display waiting queue
+    buffer_printf(out, "\nWaiting Queue:\n");
+    if (sys->wait_queue_count == 0) {
+        buffer_printf(out, "No processes waiting\n");
+    }
+    for (int w = sys->wait_queue_front; w >= 0; w = sys->wait_queue[w].next) {
+        buffer_printf(out, "Process %d: Waiting for %" PRIkb "KB\n",
+                      sys->wait_queue[w].process_id,
+                      sys->wait_queue[w].memory_size);
+        if (page_row(out, &rows) != 0) {
+            return;
+        }
+    }
+    buffer_printf(out, "\n");
+    buffer_flush(out);
+}
+
+// Display interactive menu options
+void display_menu() {
+    printf("--Main Menu--\n");
+    printf("1. Allocate Memory\n");
+    printf("2. Free Memory\n");
+    printf("3. Compact Memory\n");
+    printf("4. Show Full Layout\n");
+    printf("5. Exit\n");
+    printf("Enter your choice: ");
+}
+
+// Header of the binary trace and metrics files, followed by fixed-size records in host
+// byte order
+typedef struct {
+    char magic[8];          // TRACE_MAGIC or METRICS_MAGIC
+    uint32_t version;       // TRACE_VERSION or METRICS_VERSION
+    uint32_t record_size;   // sizeof(TraceRecord) or sizeof(MetricsSample), checked on read
+} TraceHeader;
+
+// One event of a trace, stored as is in binary traces
+typedef struct {
+    uint8_t op;             // 'a' allocate, 'f' free or 'c' compact, as in text traces
+    uint8_t flags;          // TRACE_TIMED when timestamp holds the event time
+    uint16_t reserved;      // Zero
+    int32_t process_id;     // Process the event applies to (0 for compactions)
+    int32_t size;           // Requested size in KB for allocations (0 otherwise)
+    uint32_t timestamp;     // Event time on the logical clock, if TRACE_TIMED
+    uint32_t duration;      // Allocations: simulated time the process runs once placed (0: until freed)
+} TraceRecord;
+
+// Shape of a generated size or lifetime distribution
+typedef enum {
+    DIST_UNIFORM,       // Uniform integers in [a, b]
+    DIST_EXPONENTIAL,   // Exponential with mean a
+    DIST_LOGNORMAL,     // exp(N(a, b^2))
+    DIST_BIMODAL,       // a, or b with probability p
+    DIST_HISTOGRAM      // Replayed histogram: values drawn by their weights
+} DistributionKind;
+
+// Random distribution of sizes (KB) or lifetimes (events)
+typedef struct {
+    DistributionKind kind;  // Shape of the distribution
+    double a;               // First parameter (see DistributionKind)
+    double b;               // Second parameter
+    double p;               // Probability of the second mode (bimodal)
+    long *values;           // Histogram: distinct values
+    double *cumulative;     // Histogram: running total of the weights up to each value
+    int count;              // Histogram: number of values
+} Distribution;
+
+// Options of the synthetic workload generator
+typedef struct {
+    long events;                // Number of events to generate
+    unsigned long long seed;    // Seed of the random stream; equal seeds give equal workloads
+    Distribution sizes;         // Request sizes in KB
+    Distribution lifetimes;     // Events between a process's allocation and its free
+    double occupancy;           // Target live memory as a fraction of total memory (0: none)
+} WorkloadConfig;
+
+// A generated process waiting for its scheduled free
+typedef struct {
+    long death;                 // Event number at which the process is freed
+    int process_id;             // Process to free
+    int size;                   // Its requested size in KB
+} PendingFree;
+
+// State of a generated workload; events are produced one at a time
+typedef struct {
+    const WorkloadConfig *config;  // Distributions and limits
+    unsigned long long state;      // Random generator state
+    long produced;                 // Events produced so far (the generator's clock)
+    long live;                     // KB requested by processes not yet freed
+    long target_live;              // Live KB above which frees are issued first (0: none)
+    int next_pid;                  // Process id of the next allocation
+    PendingFree *pending;          // Min-heap of scheduled frees by death
+    int pending_count;             // Number of scheduled frees
+    int pending_capacity;          // Allocated length of pending
+} WorkloadGenerator;
+
+// One sample of the metrics time series, stored as is in binary metrics files
+typedef struct {
+    int64_t event;                  // Number of events applied when the sample was taken
+    int64_t clock;                  // Logical clock at the sample
+    double external_fragmentation;  // 1 - largest free block / total free memory
+    double failure_rate;            // Share of the interval's allocations that had to wait
+    int32_t free_blocks;            // Number of free blocks
+    int32_t live_processes;         // Number of active processes
+    int32_t waiting;                // Wait-queue depth
+    int32_t reserved;               // Padding, always 0
+    int64_t free_kb;                // Total free memory in KB
+} MetricsSample;
+
+// Where and how often to record the metrics time series
+typedef struct {
+    const char *path;               // Output file ("-" for stdout)
+    int binary;                     // Write MetricsSample records instead of CSV lines
+    long interval;                  // Events between samples
+} MetricsOptions;
+
+// Snapshot files a batch run starts from and ends in
+typedef struct {
+    const char *restore_path;       // Start from this snapshot instead of the block list (NULL: no)
+    const char *save_path;          // Save the final state here (NULL: no)
+} SnapshotOptions;
+
+// Writer of the metrics time series, fed after every replayed event
+typedef struct {
+    FILE *out;                      // Output stream
+    int binary;                     // Write MetricsSample records instead of CSV lines
+    long interval;                  // Events between samples
+    long countdown;                 // Events left until the next sample
+    long last_allocations;          // Allocation events at the previous sample
+    long last_placed;               // Immediately placed allocations at the previous sample
+} MetricsSampler;
+
+// Values one simulation publishes for the telemetry reporter
+typedef struct {
+    int job;                        // Sweep job being replayed (1-based; 0 outside a sweep or when idle)
+    long jobs_done;                 // Sweep jobs this worker has finished
+    long events;                    // Events applied, including those of finished jobs
+    long allocations;               // Allocation events of the current run
+    long placed;                    // Of those, allocations placed immediately
+    long frees;                     // Free events of the current run
+    long departed;                  // Processes freed by their departure
+    int active;                     // Active processes
+    int waiting;                    // Wait-queue depth
+    int free_blocks;                // Number of free blocks
+    long free_kb;                   // Total free memory in KB
+    long largest_free_kb;           // Largest free block in KB
+    double external_fragmentation;  // 1 - largest free block / total free memory
+    long internal_fragmentation_kb; // KB allocated beyond what live processes requested
+    long merges;                    // Neighbour merges
+    long compactions;               // Compaction passes
+    long wait_p99;                  // 99th percentile wait of served waiters
+#ifdef FF_STATS
+    long blocks_scanned;            // Blocks and index nodes scanned by placements
+    long splits;                    // Block splits
+    long drains;                    // Wait-queue drains
+#endif
+} TelemetryValues;
+
+// Number of 64-bit words the published copy of a TelemetryValues occupies
+#define TELEMETRY_WORDS ((sizeof(TelemetryValues) + sizeof(uint64_t) - 1) / sizeof(uint64_t))
+
+// One simulation's published values behind a sequence lock. Its single writer makes `seq`
+// odd while it updates `words` and even again when done, so it never waits for a reader;
+// readers retry until they copy the words between two equal, even sequence numbers. The
+// words are relaxed atomics, so a reader overlapping a publish is a retry, not a data race.
+typedef struct {
+    atomic_uint seq;                // Sequence number, odd while the words are being written
+    _Atomic uint64_t words[TELEMETRY_WORDS]; // Byte image of the latest published values
+    TelemetryValues current;        // Writer only: the values last published
+    long countdown;                 // Writer only: events left until the next publish
+    long base_events;               // Writer only: events of this worker's finished jobs
+} __attribute__((aligned(64))) TelemetrySlot;
+
+// Where, how and how often the telemetry reporter writes
+typedef struct {
+    const char *path;               // Output file, or "unix:PATH" for a Unix stream socket (NULL: off)
+    int json;                       // One JSON line per report instead of Prometheus text
+    long interval_ms;               // Milliseconds between reports
+} TelemetryOptions;
+
+// Counters gathered while replaying a trace in batch mode
+typedef struct {
+    long events;        // Total number of trace events applied
+    long allocations;   // Number of allocation events
+    long placed;        // Allocations that were placed immediately
+    kb_t last_address;  // Address returned to the latest allocation event (-1: it was not placed)
+    long frees;         // Number of free events
+    long not_found;     // Free events naming a process that was not active
+    long compactions;   // Number of compaction events
+    long batch;         // Events applied per batch, draining the wait queue once each (0: per event)
+    long batches;       // Number of batches completed
+    int keep_departures; // Leave departures still scheduled at the end for a saved snapshot
+    MetricsSampler *metrics; // Time-series sampler fed after every event (NULL: none)
+    TelemetrySlot *telemetry; // Slot the run publishes its values to (NULL: none)
+} ReplayStats;
+
+// Parse a comma separated list of block sizes (e.g. "100,500,200")
+// On success *block_sizes points to a heap array the caller must free
+// Returns the number of blocks parsed, or -1 if the list is malformed
+int parse_block_list(const char *list, kb_t **block_sizes) {
+    // Every size is followed by at most one comma, which bounds the count
+    int max_blocks = 1;
+    for (const char *c = list; *c != '\0'; c++) {
+        if (*c == ',') {
+            max_blocks++;
+        }
+    }
+    *block_sizes = malloc((size_t)max_blocks * sizeof(kb_t));
+    if (*block_sizes == NULL) {
+        return -1;
+    }
+
+    // The blocks are laid out back to back, so their total must be addressable too
+    int count = 0;
+    kb_t total = 0;
+    const char *p = list;
+    while (*p != '\0') {
+        char *endptr;
+        long long value = strtoll(p, &endptr, 10);
+        if (endptr == p || value < 1 || value > KB_MAX - total || count >= max_blocks) {
+            free(*block_sizes);
+            *block_sizes = NULL;
+            return -1;
+        }
+        (*block_sizes)[count++] = (kb_t)value;
+        total += (kb_t)value;
+
+        // Accept a single comma between sizes
+        if (*endptr == ',') {
+            endptr++;
+        } else if (*endptr != '\0') {
+            free(*block_sizes);
+            *block_sizes = NULL;
+            return -1;
+        }
+        p = endptr;
+    }
+    return count;
+}
+
+// Parse a comma separated list of segregated-fit size-class bounds (e.g. "16,64,256")
+// On success *size_classes points to a heap array the caller must free
+// Returns the number of classes, or -1 unless there are 1 to MAX_SIZE_CLASSES - 1 strictly
+// increasing sizes
+int parse_size_classes(const char *list, kb_t **size_classes) {
+    int count = parse_block_list(list, size_classes);
+    int valid = count >= 1 && count < MAX_SIZE_CLASSES;
+    for (int k = 1; valid && k < count; k++) {
+        valid = (*size_classes)[k] > (*size_classes)[k - 1];
+    }
+    if (!valid) {
+        free(*size_classes);
+        *size_classes = NULL;
+        return -1;
+    }
+    return count;
+}
+
+// Parse a whole decimal number between 0 and `max` into *value
+// Returns 0 on success, -1 if the text is empty, has trailing characters or is out of range
+int parse_count(const char *text, long max, long *value) {
+    char *endptr;
+    errno = 0;
+    long parsed = strtol(text, &endptr, 10);
+    if (endptr == text || *endptr != '\0' || errno != 0 || parsed < 0 || parsed > max) {
+        return -1;
+    }
+    *value = parsed;
+    return 0;
+}
+
+// Open a metrics time-series file and write its header
+// Returns 0 on success, -1 if the file cannot be created
+int metrics_open(MetricsSampler *sampler, const MetricsOptions *options) {
+    memset(sampler, 0, sizeof(MetricsSampler));
+    sampler->out = strcmp(options->path, "-") == 0 ? stdout : fopen(options->path, options->binary ? "wb" : "w");
+    if (sampler->out == NULL) {
+        perror(options->path);
+        return -1;
+    }
+    sampler->binary = options->binary;
+    sampler->interval = options->interval;
+    sampler->countdown = options->interval;
+    if (sampler->binary) {
+        TraceHeader header = {METRICS_MAGIC, METRICS_VERSION, sizeof(MetricsSample)};
+        fwrite(&header, sizeof(header), 1, sampler->out);
+    } else {
+        fprintf(sampler->out, "event,clock,external_fragmentation,failure_rate,free_blocks,"
+                              "live_processes,waiting,free_kb\n");
+    }
+    return 0;
+}
+
+// Record one sample from the incremental counters; no block is visited
+void sample_metrics(MetricsSampler *sampler, SystemMemory *sys, const ReplayStats *stats) {
+    long allocations = stats->allocations - sampler->last_allocations;
+    long waited = allocations - (stats->placed - sampler->last_placed);
+    MetricsSample sample = {
+        stats->events, sys->clock, external_fragmentation(sys),
+        allocations > 0 ? (double)waited / allocations : 0.0,
+        get_free_block_count(sys), sys->num_processes, sys->wait_queue_count, 0, get_total_free_memory(sys)
+    };
+    sampler->last_allocations = stats->allocations;
+    sampler->last_placed = stats->placed;
+    if (sampler->binary) {
+        fwrite(&sample, sizeof(sample), 1, sampler->out);
+    } else {
+        fprintf(sampler->out, "%lld,%lld,%.6f,%.6f,%d,%d,%d,%lld\n", (long long)sample.event,
+                (long long)sample.clock, sample.external_fragmentation, sample.failure_rate,
+                sample.free_blocks, sample.live_processes, sample.waiting, (long long)sample.free_kb);
+    }
+}
+
+// Flush and close a metrics file
+// Returns 0 on success, -1 if writing failed
+int metrics_close(MetricsSampler *sampler) {
+    int failed = ferror(sampler->out);
+    if (sampler->out != stdout) {
+        failed |= fclose(sampler->out);
+    } else {
+        failed |= fflush(sampler->out);
+    }
+    return failed ? -1 : 0;
+}
+
+// Copy the writer's current values into the slot's published words under the sequence lock
+static void telemetry_store(TelemetrySlot *slot) {
+    uint64_t words[TELEMETRY_WORDS] = {0};
+    memcpy(words, &slot->current, sizeof(TelemetryValues));
+    unsigned int seq = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+    atomic_store_explicit(&slot->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for (size_t i = 0; i < TELEMETRY_WORDS; i++) {
+        atomic_store_explicit(&slot->words[i], words[i], memory_order_relaxed);
+    }
+    atomic_store_explicit(&slot->seq, seq + 2, memory_order_release);
+    slot->countdown = TELEMETRY_PUBLISH_EVENTS;
+}
+
+// Publish a simulation's current values to its telemetry slot. The values are gathered
+// first, so the write section the reporter can collide with is a single copy.
+void telemetry_publish(TelemetrySlot *slot, SystemMemory *sys, const ReplayStats *stats) {
+    TelemetryValues values = slot->current;
+    values.events = slot->base_events + stats->events;
+    values.allocations = stats->allocations;
+    values.placed = stats->placed;
+    values.frees = stats->frees;
+    values.departed = sys->departed;
+    values.active = sys->num_processes;
+    values.waiting = sys->wait_queue_count;
+    values.free_blocks = get_free_block_count(sys);
+    values.free_kb = get_total_free_memory(sys);
+    values.largest_free_kb = get_largest_free_block(sys);
+    values.external_fragmentation = external_fragmentation(sys);
+    values.internal_fragmentation_kb = sys->internal_fragmentation;
+    values.merges = sys->merges;
+    values.compactions = sys->compactions;
+    values.wait_p99 = histogram_percentile(&sys->wait_times, 99);
+#ifdef FF_STATS
+    values.blocks_scanned = sys->stats.blocks_scanned + sys->free_index.visits;
+    values.splits = sys->stats.splits;
+    values.drains = sys->stats.drains;
+#endif
+    slot->current = values;
+    telemetry_store(slot);
+}
+
+// Set the job a sweep worker's slot reports, and fold the finished job's events into its total
+void telemetry_set_job(TelemetrySlot *slot, int job, long finished_events) {
+    if (job == 0) {
+        slot->base_events += finished_events;
+        slot->current.jobs_done++;
+    }
+    slot->current.job = job;
+    slot->current.events = slot->base_events;
+    telemetry_store(slot);
+}
+
+// Copy a consistent set of published values out of a slot without stopping its writer
+void telemetry_read(TelemetrySlot *slot, TelemetryValues *values) {
+    uint64_t words[TELEMETRY_WORDS];
+    unsigned int before, after;
+    do {
+        before = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        for (size_t i = 0; i < TELEMETRY_WORDS; i++) {
+            words[i] = atomic_load_explicit(&slot->words[i], memory_order_relaxed);
+        }
+        atomic_thread_fence(memory_order_acquire);
+        after = atomic_load_explicit(&slot->seq, memory_order_relaxed);
+    } while ((before & 1) != 0 || before != after);
+    memcpy(values, words, sizeof(TelemetryValues));
+}
+
+// Background thread writing the values of a set of telemetry slots at a fixed interval
+typedef struct {
+    TelemetryOptions options;       // Output and format
+    TelemetrySlot *slots;           // One slot per simulation thread
+    int count;                      // Number of slots
+    pthread_t thread;               // Reporter thread
+    pthread_mutex_t lock;           // Guards stop, for the timed wait between reports
+    pthread_cond_t wake;            // Signalled to stop the reporter early
+    int stop;                       // Set when the simulation is over
+    int fd;                         // Connected socket or appended file (-1: none yet)
+    int socket;                     // Output is a Unix socket
+    char *temp_path;                // Prometheus file output: written here, then renamed
+    struct timespec start;          // When reporting started
+    double last_seconds;            // Time of the previous report
+    long last_events;               // Events summed over all slots at the previous report
+    long reports;                   // Reports written
+    OutputBuffer out;               // Text of the report being written
+} TelemetryReporter;
+
+// Open (or reconnect) the reporter's output; a socket nobody listens on yet is retried
+// at the next report. Returns 0 on success, -1 if the output is not open
+int telemetry_connect(TelemetryReporter *reporter) {
+    if (reporter->fd >= 0) {
+        return 0;
+    }
+    if (reporter->socket) {
+        struct sockaddr_un address = {0};
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, reporter->options.path + 5, sizeof(address.sun_path) - 1);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, (const struct sockaddr *)&address, sizeof(address)) == 0) {
+            reporter->fd = fd;
+        } else if (fd >= 0) {
+            close(fd);
+        }
+    } else if (reporter->options.json) {
+        reporter->fd = open(reporter->options.path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    }
+    return reporter->fd >= 0 ? 0 : -1;
+}
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Write the buffered report. A Prometheus file is replaced in one rename, so a scraper never
+// reads half of it; a socket that would block or was closed drops the report.
+void telemetry_write(TelemetryReporter *reporter) {
+    OutputBuffer *out = &reporter->out;
+    if (!reporter->socket && !reporter->options.json) {
+        int fd = open(reporter->temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd >= 0) {
+            int complete = write(fd, out->data, (size_t)out->length) == out->length;
+            if (close(fd) == 0 && complete) {
+                rename(reporter->temp_path, reporter->options.path);
+            }
+        }
+    } else if (telemetry_connect(reporter) == 0) {
+        ssize_t written = reporter->socket ?
+                          send(reporter->fd, out->data, (size_t)out->length, MSG_NOSIGNAL | MSG_DONTWAIT) :
+                          write(reporter->fd, out->data, (size_t)out->length);
+        if (written < 0 && reporter->socket && errno != EAGAIN && errno != EWOULDBLOCK) {
+            close(reporter->fd);
+            reporter->fd = -1;
+        }
+    }
+    out->length = 0;
+}
+
+// Format one report of every slot: Prometheus text with a `worker` label per series, or a
+// JSON line with one object per worker
+void telemetry_report(TelemetryReporter *reporter) {
+    TelemetryValues *values = malloc((size_t)reporter->count * sizeof(TelemetryValues));
+    if (values == NULL) {
+        return;
+    }
+    long events = 0;
+    for (int w = 0; w < reporter->count; w++) {
+        telemetry_read(&reporter->slots[w], &values[w]);
+        events += values[w].events;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double seconds = elapsed_seconds(&reporter->start, &now);
+    double rate = seconds > reporter->last_seconds ?
+                  (events - reporter->last_events) / (seconds - reporter->last_seconds) : 0.0;
+    reporter->last_seconds = seconds;
+    reporter->last_events = events;
+    reporter->reports++;
+
+    // Name, help text, type and offset of every per-worker series, as long or double values
+    static const struct {
+        const char *name;
+        const char *help;
+        const char *type;
+        size_t offset;
+        int is_double;
+    } series[] = {
+        {"events_total", "Events applied", "counter", offsetof(TelemetryValues, events), 0},
+        {"jobs_done_total", "Sweep jobs finished", "counter", offsetof(TelemetryValues, jobs_done), 0},
+        {"allocations", "Allocation events of the current run", "gauge", offsetof(TelemetryValues, allocations), 0},
+        {"placed", "Allocations of the current run placed immediately", "gauge", offsetof(TelemetryValues, placed), 0},
+        {"frees", "Free events of the current run", "gauge", offsetof(TelemetryValues, frees), 0},
+        {"departed", "Processes freed by their departure", "gauge", offsetof(TelemetryValues, departed), 0},
+        {"free_kb", "Total free memory in KB", "gauge", offsetof(TelemetryValues, free_kb), 0},
+        {"largest_free_kb", "Largest free block in KB", "gauge", offsetof(TelemetryValues, largest_free_kb), 0},
+        {"external_fragmentation", "1 - largest free block / total free memory", "gauge",
+         offsetof(TelemetryValues, external_fragmentation), 1},
+        {"internal_fragmentation_kb", "KB allocated beyond the live requests", "gauge",
+         offsetof(TelemetryValues, internal_fragmentation_kb), 0},
+        {"merges", "Neighbour merges of the current run", "gauge", offsetof(TelemetryValues, merges), 0},
+        {"compactions", "Compaction passes of the current run", "gauge", offsetof(TelemetryValues, compactions), 0},
+        {"wait_p99", "99th percentile wait of served waiters", "gauge", offsetof(TelemetryValues, wait_p99), 0},
+#ifdef FF_STATS
+        {"blocks_scanned", "Blocks and index nodes scanned by placements", "gauge",
+         offsetof(TelemetryValues, blocks_scanned), 0},
+        {"splits", "Block splits of the current run", "gauge", offsetof(TelemetryValues, splits), 0},
+        {"drains", "Wait-queue drains of the current run", "gauge", offsetof(TelemetryValues, drains), 0},
+#endif
+    };
+    static const struct {
+        const char *name;
+        const char *help;
+        size_t offset;
+    } int_series[] = {
+        {"job", "Sweep job being replayed (0: none)", offsetof(TelemetryValues, job)},
+        {"active_processes", "Active processes", offsetof(TelemetryValues, active)},
+        {"waiting", "Wait-queue depth", offsetof(TelemetryValues, waiting)},
+        {"free_blocks", "Number of free blocks", offsetof(TelemetryValues, free_blocks)},
+    };
+    size_t num_series = sizeof(series) / sizeof(series[0]);
+    size_t num_int_series = sizeof(int_series) / sizeof(int_series[0]);
+
+    OutputBuffer *out = &reporter->out;
+    if (reporter->options.json) {
+        buffer_printf(out, "{\"uptime_seconds\":%.3f,\"events_per_second\":%.0f,\"workers\":[", seconds, rate);
+        for (int w = 0; w < reporter->count; w++) {
+            const char *base = (const char *)&values[w];
+            buffer_printf(out, "%s{\"worker\":%d", w > 0 ? "," : "", w);
+            for (size_t i = 0; i < num_int_series; i++) {
+                buffer_printf(out, ",\"%s\":%d", int_series[i].name, *(const int *)(base + int_series[i].offset));
+            }
+            for (size_t i = 0; i < num_series; i++) {
+                if (series[i].is_double) {
+                    buffer_printf(out, ",\"%s\":%.6f", series[i].name, *(const double *)(base + series[i].offset));
+                } else {
+                    buffer_printf(out, ",\"%s\":%ld", series[i].name, *(const long *)(base + series[i].offset));
+                }
+            }
+            buffer_printf(out, "}");
+        }
+        buffer_printf(out, "]}\n");
+    } else {
+        buffer_printf(out, "# HELP ffsim_uptime_seconds Seconds since reporting started\n"
+                      "# TYPE ffsim_uptime_seconds gauge\nffsim_uptime_seconds %.3f\n", seconds);
+        buffer_printf(out, "# HELP ffsim_events_per_second Events applied per second since the last report\n"
+                      "# TYPE ffsim_events_per_second gauge\nffsim_events_per_second %.0f\n", rate);
+        for (size_t i = 0; i < num_int_series; i++) {
+            buffer_printf(out, "# HELP ffsim_%s %s\n# TYPE ffsim_%s gauge\n", int_series[i].name,
+                          int_series[i].help, int_series[i].name);
+            for (int w = 0; w < reporter->count; w++) {
+                buffer_printf(out, "ffsim_%s{worker=\"%d\"} %d\n", int_series[i].name, w,
+                              *(const int *)((const char *)&values[w] + int_series[i].offset));
+            }
+        }
+        for (size_t i = 0; i < num_series; i++) {
+            buffer_printf(out, "# HELP ffsim_%s %s\n# TYPE ffsim_%s %s\n", series[i].name, series[i].help,
+                          series[i].name, series[i].type);
+            for (int w = 0; w < reporter->count; w++) {
+                const char *field = (const char *)&values[w] + series[i].offset;
+                if (series[i].is_double) {
+                    buffer_printf(out, "ffsim_%s{worker=\"%d\"} %.6f\n", series[i].name, w, *(const double *)field);
+                } else {
+                    buffer_printf(out, "ffsim_%s{worker=\"%d\"} %ld\n", series[i].name, w, *(const long *)field);
+                }
+            }
+        }
+        if (reporter->socket) {
+            buffer_printf(out, "# EOF\n");
+        }
+    }
+    free(values);
+    telemetry_write(reporter);
+}
+
+// Reporter thread: write a report every interval until stopped, then a final one. The final
+// report comes after the loop, so it is written even if the run ended before the thread began.
+void *telemetry_thread(void *arg) {
+    TelemetryReporter *reporter = arg;
+    pthread_mutex_lock(&reporter->lock);
+    while (!reporter->stop) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += reporter->options.interval_ms / 1000;
+        deadline.tv_nsec += (reporter->options.interval_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        while (!reporter->stop && pthread_cond_timedwait(&reporter->wake, &reporter->lock, &deadline) == 0) {
+        }
+        if (reporter->stop) {
+            break;
+        }
+        pthread_mutex_unlock(&reporter->lock);
+        telemetry_report(reporter);
+        pthread_mutex_lock(&reporter->lock);
+    }
+    pthread_mutex_unlock(&reporter->lock);
+    telemetry_report(reporter);
+    return NULL;
+}
+
+// Start reporting `count` fresh slots in the background
+// Returns the slots, or NULL if they or the output could not be set up
+TelemetrySlot *telemetry_start(TelemetryReporter *reporter, const TelemetryOptions *options, int count) {
+    memset(reporter, 0, sizeof(TelemetryReporter));
+    reporter->options = *options;
+    reporter->count = count;
+    reporter->fd = -1;
+    reporter->socket = strncmp(options->path, "unix:", 5) == 0;
+    if (posix_memalign((void **)&reporter->slots, 64, (size_t)count * sizeof(TelemetrySlot)) != 0) {
+        fprintf(stderr, "Could not allocate telemetry slots\n");
+        return NULL;
+    }
+    memset(reporter->slots, 0, (size_t)count * sizeof(TelemetrySlot));
+    for (int w = 0; w < count; w++) {
+        reporter->slots[w].countdown = TELEMETRY_PUBLISH_EVENTS;
+    }
+
+    if (!reporter->socket && !reporter->options.json) {
+        reporter->temp_path = malloc(strlen(options->path) + 5);
+        if (reporter->temp_path != NULL) {
+            sprintf(reporter->temp_path, "%s.tmp", options->path);
+        }
+    }
+    if ((!reporter->socket && !reporter->options.json && reporter->temp_path == NULL) ||
+        (!reporter->socket && reporter->options.json && telemetry_connect(reporter) != 0)) {
+        perror(options->path);
+        free(reporter->temp_path);
+        free(reporter->slots);
+        return NULL;
+    }
+    if (reporter->socket) {
+        telemetry_connect(reporter);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &reporter->start);
+    pthread_mutex_init(&reporter->lock, NULL);
+    pthread_cond_init(&reporter->wake, NULL);
+    if (pthread_create(&reporter->thread, NULL, telemetry_thread, reporter) != 0) {
+        fprintf(stderr, "Could not start the telemetry reporter\n");
+        if (reporter->fd >= 0) {
+            close(reporter->fd);
+        }
+        free(reporter->temp_path);
+        free(reporter->slots);
+        return NULL;
+    }
+    return reporter->slots;
+}
+
+// Stop the reporter after a final report and release it
+void telemetry_stop(TelemetryReporter *reporter) {
+    pthread_mutex_lock(&reporter->lock);
+    reporter->stop = 1;
+    pthread_cond_signal(&reporter->wake);
+    pthread_mutex_unlock(&reporter->lock);
+    pthread_join(reporter->thread, NULL);
+    pthread_mutex_destroy(&reporter->lock);
+    pthread_cond_destroy(&reporter->wake);
+    if (reporter->fd >= 0) {
+        close(reporter->fd);
+    }
+    free(reporter->temp_path);
+    free(reporter->slots);
+    free(reporter->out.data);
+}
+
+// Parse one line of a text trace into an event record
+// Supported events: "a <pid> <size>" allocates, "f <pid>" frees, "c" compacts memory.
+// Any event may end with an optional event time, e.g. "a 7 120 3500", and an allocation
+// with a duration after which the process departs, e.g. "a 7 120 3500 +250" ("+0": until
+// freed). Blank lines and lines starting with '#' are ignored.
+// Returns 1 if the line holds an event, 0 if it was skipped, -1 on a parse error
+int parse_trace_line(const char *line, TraceRecord *record) {
+    const char *p = line;
+    while (*p == ' ' || *p == '\t') {
+        p++;
+    }
+    if (*p == '\0' || *p == '\n' || *p == '\r' || *p == '#') {
+        return 0;
+    }
+
+    memset(record, 0, sizeof(TraceRecord));
+    record->op = (uint8_t)*p++;
+    char *endptr;
+    if (record->op == 'a' || record->op == 'f') {
+        long process_id = strtol(p, &endptr, 10);
+        if (endptr == p || process_id < 1 || process_id > INT_MAX) {
+            return -1;
+        }
+        record->process_id = (int32_t)process_id;
+        p = endptr;
+    }
+    if (record->op == 'a') {
+        long size = strtol(p, &endptr, 10);
+        if (endptr == p || size < 1 || size > INT_MAX) {
+            return -1;
+        }
+        record->size = (int32_t)size;
+        p = endptr;
+    } else if (record->op != 'f' && record->op != 'c') {
+        return -1;
+    }
+
+    // Optional event time, then for allocations an optional "+duration"
+    while (*p == ' ' || *p == '\t') {
+        p++;
+    }
+    long long timestamp = *p == '+' ? 0 : strtoll(p, &endptr, 10);
+    if (*p != '+' && endptr != p) {
+        if (timestamp < 0 || timestamp > UINT32_MAX) {
+            return -1;
+        }
+        record->flags = TRACE_TIMED;
+        record->timestamp = (uint32_t)timestamp;
+        p = endptr;
+        while (*p == ' ' || *p == '\t') {
+            p++;
+        }
+    }
+    if (record->op == 'a' && *p == '+') {
+        long long duration = strtoll(p + 1, &endptr, 10);
+        if (endptr == p + 1 || duration < 0 || duration > UINT32_MAX) {
+            return -1;
+        }
+        record->duration = (uint32_t)duration;
+        p = endptr;
+    }
+
+    // Nothing may follow the last field
+    while (*p == ' ' || *p == '\t') {
+        p++;
+    }
+    if (*p != '\0' && *p != '\n' && *p != '\r') {
+        return -1;
+    }
+    return 1;
+}
+
+// Write one trace event as a line of a text trace
+void write_trace_record(FILE *out, const TraceRecord *record) {
+    if (record->op == 'a') {
+        fprintf(out, "a %d %d", record->process_id, record->size);
+    } else if (record->op == 'f') {
+        fprintf(out, "f %d", record->process_id);
+    } else {
+        fprintf(out, "%c", record->op);
+    }
+    if (record->flags & TRACE_TIMED) {
+        fprintf(out, " %" PRIu32, record->timestamp);
+    }
+    if (record->op == 'a' && record->duration > 0) {
+        fprintf(out, " +%" PRIu32, record->duration);
+    }
+    fprintf(out, "\n");
+}
+
+// Apply one trace event to the system; the event time, if any, sets the logical clock, and
+// departures due by then run first
+// Returns 0 on success, -1 if the record is malformed or its event time is before the clock
+int apply_trace_record(SystemMemory *sys, const TraceRecord *record, ReplayStats *stats) {
+    // Going back in time would give negative waits and schedule departures in the past
+    if ((record->flags & TRACE_TIMED) && (long)record->timestamp < sys->clock) {
+        return -1;
+    }
+    if (stats->batch > 0 && !sys->in_batch) {
+        begin_batch(sys);
+    }
+    set_clock(sys, record->flags & TRACE_TIMED ? (long)record->timestamp : sys->clock + 1);
+
+    switch (record->op) {
+        case 'a':
+            if (record->process_id < 1 || record->size < 1) {
+                return -1;
+            }
+            stats->allocations++;
+            stats->last_address = allocate_for(sys, record->process_id, record->size, record->duration);
+            if (stats->last_address != -1) {
+                stats->placed++;
+            }
+            break;
+        case 'f':
+            if (record->process_id < 1) {
+                return -1;
+            }
+            stats->frees++;
+            if (!free_memory(sys, record->process_id)) {
+                stats->not_found++;
+            }
+            break;
+        case 'c':
+            stats->compactions++;
+            compact_memory(sys);
+            schedule_drain(sys);
+            break;
+        default:
+            return -1;
+    }
+
+    stats->events++;
+    if (stats->batch > 0 && stats->events % stats->batch == 0) {
+        end_batch(sys);
+        stats->batches++;
+    }
+    if (stats->metrics != NULL && --stats->metrics->countdown == 0) {
+        sample_metrics(stats->metrics, sys, stats);
+        stats->metrics->countdown = stats->metrics->interval;
+    }
+    if (stats->telemetry != NULL && --stats->telemetry->countdown == 0) {
+        telemetry_publish(stats->telemetry, sys, stats);
+    }
+    return 0;
+}
+
+// Finish a replay: end its last, partial batch, then run the simulation on until every
+// scheduled departure has happened, unless they are kept for a later run
+static inline void finish_replay(SystemMemory *sys, ReplayStats *stats) {
+    if (sys->in_batch) {
+        end_batch(sys);
+        stats->batches++;
+    }
+    if (!stats->keep_departures) {
+        run_departures(sys, LONG_MAX);
+    }
+    if (stats->telemetry != NULL) {
+        telemetry_publish(stats->telemetry, sys, stats);
+    }
+}
+
+// Replay a text trace without rendering the memory layout between events
+// Returns 0 on success, -1 if the trace contains a malformed line
+int replay_trace(SystemMemory *sys, FILE *in, ReplayStats *stats) {
+    char line[256];
+    long line_number = 0;
+    TraceRecord record;
+
+    while (fgets(line, sizeof(line), in) != NULL) {
+        line_number++;
+        int parsed = parse_trace_line(line, &record);
+        if (parsed < 0 || (parsed > 0 && apply_trace_record(sys, &record, stats) != 0)) {
+            fprintf(stderr, "Malformed trace event on line %ld: %s", line_number, line);
+            return -1;
+        }
+    }
+    finish_replay(sys, stats);
+    return 0;
+}
+
+// Replay the records of a memory-mapped binary trace in place
+// Returns 0 on success, -1 if the trace contains a malformed record
+int replay_binary_trace(SystemMemory *sys, const TraceRecord *records, long count, ReplayStats *stats) {
+    for (long i = 0; i < count; i++) {
+        if (apply_trace_record(sys, &records[i], stats) != 0) {
+            fprintf(stderr, "Malformed trace record %ld (op 0x%02x)\n", i, records[i].op);
+            return -1;
+        }
+    }
+    finish_replay(sys, stats);
+    return 0;
+}
+
+// Map a trace file and check for the binary trace header
+// Returns the mapping (*length bytes) if the file is a binary trace, or NULL otherwise
+const TraceHeader *map_binary_trace(const char *path, size_t *length) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (size_t)st.st_size < sizeof(TraceHeader)) {
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+
+    const TraceHeader *header = map;
+    if (memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic)) != 0) {
+        munmap(map, (size_t)st.st_size);
+        return NULL;
+    }
+    posix_madvise(map, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+    *length = (size_t)st.st_size;
+    return header;
+}
+
+// Convert a text trace ("-" reads stdin) into the binary trace format
+int convert_trace(const char *in_path, const char *out_path) {
+    FILE *in = strcmp(in_path, "-") == 0 ? stdin : fopen(in_path, "r");
+    if (in == NULL) {
+        perror(in_path);
+        return 1;
+    }
+    FILE *out = fopen(out_path, "wb");
+    if (out == NULL) {
+        perror(out_path);
+        if (in != stdin) {
+            fclose(in);
+        }
+        return 1;
+    }
+
+    TraceHeader header = {TRACE_MAGIC, TRACE_VERSION, sizeof(TraceRecord)};
+    int result = fwrite(&header, sizeof(header), 1, out) == 1 ? 0 : 1;
+    char line[256];
+    long line_number = 0;
+    long events = 0;
+    TraceRecord record;
+    while (result == 0 && fgets(line, sizeof(line), in) != NULL) {
+        line_number++;
+        int parsed = parse_trace_line(line, &record);
+        if (parsed < 0) {
+            fprintf(stderr, "Malformed trace event on line %ld: %s", line_number, line);
+            result = 1;
+        } else if (parsed > 0) {
+            result = fwrite(&record, sizeof(record), 1, out) == 1 ? 0 : 1;
+            events++;
+        }
+    }
+    if (fclose(out) != 0) {
+        result = 1;
+    }
+    if (in != stdin) {
+        fclose(in);
+    }
+    if (result == 0) {
+        printf("Converted %ld events to %s\n", events, out_path);
+    } else {
+        fprintf(stderr, "Could not convert %s\n", in_path);
+    }
+    return result;
+}
+
+// Random source of the workload generator (splitmix64), reproducible from its seed
+static inline unsigned long long workload_random(WorkloadGenerator *gen) {
+    unsigned long long z = (gen->state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Uniform random number in (0, 1]
+static inline double workload_uniform(WorkloadGenerator *gen) {
+    return ((double)(workload_random(gen) >> 11) + 1.0) / 9007199254740992.0;
+}
+
+// Draw a value from a distribution, clamped to [1, INT_MAX]
+int sample_distribution(WorkloadGenerator *gen, const Distribution *dist) {
+    double value;
+    switch (dist->kind) {
+        case DIST_UNIFORM:
+            value = dist->a + (double)(workload_random(gen) % (unsigned long long)(dist->b - dist->a + 1));
+            break;
+        case DIST_EXPONENTIAL:
+            value = -dist->a * log(workload_uniform(gen));
+            break;
+        case DIST_LOGNORMAL: {
+            // Box-Muller transform of two uniforms into a standard normal
+            double normal = sqrt(-2.0 * log(workload_uniform(gen))) * cos(6.283185307179586 * workload_uniform(gen));
+            value = exp(dist->a + dist->b * normal);
+            break;
+        }
+        case DIST_BIMODAL:
+            value = workload_uniform(gen) <= dist->p ? dist->b : dist->a;
+            break;
+        case DIST_HISTOGRAM: {
+            // Binary search the cumulative weights for a uniform draw
+            double target = workload_uniform(gen) * dist->cumulative[dist->count - 1];
+            int low = 0;
+            int high = dist->count - 1;
+            while (low < high) {
+                int mid = (low + high) / 2;
+                if (dist->cumulative[mid] < target) {
+                    low = mid + 1;
+                } else {
+                    high = mid;
+                }
+            }
+            value = (double)dist->values[low];
+            break;
+        }
+        default:
+            value = 1;
+    }
+    if (value < 1) {
+        return 1;
+    }
+    return value >= INT_MAX ? INT_MAX : (int)(value + 0.5);
+}
+
+// Load a replayed histogram: one "<value> <weight>" pair per line, '#' starts a comment
+// Returns 0 on success, -1 if the file cannot be read or holds no positive weight
+int load_histogram_distribution(const char *path, Distribution *dist) {
+    FILE *in = fopen(path, "r");
+    if (in == NULL) {
+        perror(path);
+        return -1;
+    }
+    int capacity = 0;
+    char line[256];
+    int result = 0;
+    while (result == 0 && fgets(line, sizeof(line), in) != NULL) {
+        long value;
+        double weight;
+        char *p = line + strspn(line, " \t");
+        if (*p == '#' || *p == '\n' || *p == '\0') {
+            continue;
+        }
+        if (sscanf(p, "%ld %lf", &value, &weight) != 2 || value < 1 || weight < 0) {
+            fprintf(stderr, "%s: expected '<value> <weight>' lines, got: %s", path, line);
+            result = -1;
+        } else if (ensure_capacity((void **)&dist->values, &capacity, dist->count + 1, sizeof(long)) != 0 ||
+                   (dist->cumulative = realloc(dist->cumulative, (size_t)capacity * sizeof(double))) == NULL) {
+            result = -1;
+        } else {
+            dist->values[dist->count] = value;
+            dist->cumulative[dist->count] = weight + (dist->count > 0 ? dist->cumulative[dist->count - 1] : 0);
+            dist->count++;
+        }
+    }
+    fclose(in);
+    if (result == 0 && (dist->count == 0 || dist->cumulative[dist->count - 1] <= 0)) {
+        fprintf(stderr, "%s: histogram has no positive weight\n", path);
+        result = -1;
+    }
+    return result;
+}
+
+// Parse a distribution such as "uniform:1:100", "exp:500", "lognormal:4:1.5",
+// "bimodal:16:4096:0.1" or "histogram:sizes.txt"
+// Returns 0 on success, -1 if the specification is malformed
+int parse_distribution(const char *spec, Distribution *dist) {
+    memset(dist, 0, sizeof(Distribution));
+    int consumed = 0;
+    if (sscanf(spec, "uniform:%lf:%lf%n", &dist->a, &dist->b, &consumed) == 2 && spec[consumed] == '\0') {
+        dist->kind = DIST_UNIFORM;
+        return dist->a >= 1 && dist->b >= dist->a && dist->b <= INT_MAX ? 0 : -1;
+    }
+    if (sscanf(spec, "exp:%lf%n", &dist->a, &consumed) == 1 && spec[consumed] == '\0') {
+        dist->kind = DIST_EXPONENTIAL;
+        return dist->a > 0 ? 0 : -1;
+    }
+    if (sscanf(spec, "lognormal:%lf:%lf%n", &dist->a, &dist->b, &consumed) == 2 && spec[consumed] == '\0') {
+        dist->kind = DIST_LOGNORMAL;
+        return dist->b >= 0 ? 0 : -1;
+    }
+    if (sscanf(spec, "bimodal:%lf:%lf:%lf%n", &dist->a, &dist->b, &dist->p, &consumed) == 3 &&
+        spec[consumed] == '\0') {
+        dist->kind = DIST_BIMODAL;
+        return dist->p >= 0 && dist->p <= 1 ? 0 : -1;
+    }
+    if (strncmp(spec, "histogram:", 10) == 0) {
+        dist->kind = DIST_HISTOGRAM;
+        return load_histogram_distribution(spec + 10, dist);
+    }
+    return -1;
+}
+
+// Release the tables of a replayed-histogram distribution
+void destroy_distribution(Distribution *dist) {
+    free(dist->values);
+    free(dist->cumulative);
+    dist->values = NULL;
+    dist->cumulative = NULL;
+    dist->count = 0;
+}
+
+// Start a generated workload against memory of `total_memory` KB
+void workload_init(WorkloadGenerator *gen, const WorkloadConfig *config, kb_t total_memory) {
+    memset(gen, 0, sizeof(WorkloadGenerator));
+    gen->config = config;
+    gen->state = config->seed;
+    gen->target_live = (long)(config->occupancy * total_memory);
+    gen->next_pid = 1;
+}
+
+// Release the pending-free heap of a workload generator
+void workload_destroy(WorkloadGenerator *gen) {
+    free(gen->pending);
+    gen->pending = NULL;
+    gen->pending_count = 0;
+    gen->pending_capacity = 0;
+}
+
+// Restore the min-heap order of pending frees after the entry at `i` moved
+static void workload_sift_down(WorkloadGenerator *gen, int i) {
+    PendingFree *heap = gen->pending;
+    while (1) {
+        int least = i;
+        int left = 2 * i + 1;
+        int right = left + 1;
+        if (left < gen->pending_count && heap[left].death < heap[least].death) {
+            least = left;
+        }
+        if (right < gen->pending_count && heap[right].death < heap[least].death) {
+            least = right;
+        }
+        if (least == i) {
+            return;
+        }
+        PendingFree swap = heap[i];
+        heap[i] = heap[least];
+        heap[least] = swap;
+        i = least;
+    }
+}
+
+// Produce the next event of a generated workload
+// Live memory is bounded by the target occupancy, so the generator needs space for the
+// pending frees only, however long the stream runs.
+// Returns 1 if an event was produced, 0 once the workload is complete or out of memory
+int workload_next(WorkloadGenerator *gen, TraceRecord *record) {
+    if (gen->produced >= gen->config->events) {
+        return 0;
+    }
+    memset(record, 0, sizeof(TraceRecord));
+
+    // Free the process that dies first once its time has come or the heap is at its target
+    PendingFree *heap = gen->pending;
+    if (gen->pending_count > 0 &&
+        (heap[0].death <= gen->produced || (gen->target_live > 0 && gen->live >= gen->target_live))) {
+        record->op = 'f';
+        record->process_id = heap[0].process_id;
+        gen->live -= heap[0].size;
+        heap[0] = heap[--gen->pending_count];
+        workload_sift_down(gen, 0);
+    } else {
+        if (ensure_capacity((void **)&gen->pending, &gen->pending_capacity,
+                            gen->pending_count + 1, sizeof(PendingFree)) != 0) {
+            return 0;
+        }
+        record->op = 'a';
+        record->process_id = gen->next_pid;
+        record->size = sample_distribution(gen, &gen->config->sizes);
+
+        // Process ids wrap around long after the first holders of small ids have died
+        gen->next_pid = gen->next_pid == INT_MAX ? 1 : gen->next_pid + 1;
+
+        // Sift the new pending free up to its place in the heap
+        heap = gen->pending;
+        int i = gen->pending_count++;
+        long death = gen->produced + sample_distribution(gen, &gen->config->lifetimes);
+        while (i > 0 && heap[(i - 1) / 2].death > death) {
+            heap[i] = heap[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        heap[i].death = death;
+        heap[i].process_id = record->process_id;
+        heap[i].size = record->size;
+        gen->live += record->size;
+    }
+    gen->produced++;
+    return 1;
+}
+
+// Replay a generated workload, streaming each event straight into the system
+// Returns 0 on success, -1 if the generator ran out of memory or produced a malformed event
+int replay_workload(SystemMemory *sys, WorkloadGenerator *gen, ReplayStats *stats) {
+    TraceRecord record;
+    while (workload_next(gen, &record)) {
+        if (apply_trace_record(sys, &record, stats) != 0) {
+            fprintf(stderr, "Malformed workload event %ld (op 0x%02x)\n", gen->produced - 1, record.op);
+            return -1;
+        }
+    }
+    finish_replay(sys, stats);
+    return gen->produced == gen->config->events ? 0 : -1;
+}
+
+// Write a generated workload as a text trace instead of replaying it
+int emit_workload(const WorkloadConfig *workload, const char *block_list, const char *out_path) {
+    kb_t *block_sizes;
+    int num_blocks = parse_block_list(block_list, &block_sizes);
+    if (num_blocks < 1) {
+        fprintf(stderr, "Invalid block list '%s' (expected sizes such as 100,500,200)\n", block_list);
+        free(block_sizes);
+        return 1;
+    }
+    kb_t total_memory = 0;
+    for (int i = 0; i < num_blocks; i++) {
+        total_memory += block_sizes[i];
+    }
+    free(block_sizes);
+
+    FILE *out = strcmp(out_path, "-") == 0 ? stdout : fopen(out_path, "w");
+    if (out == NULL) {
+        perror(out_path);
+        return 1;
+    }
+    WorkloadGenerator gen;
+    workload_init(&gen, workload, total_memory);
+    TraceRecord record;
+    while (workload_next(&gen, &record)) {
+        write_trace_record(out, &record);
+    }
+    int result = gen.produced == workload->events ? 0 : 1;
+    workload_destroy(&gen);
+    if (out != stdout && fclose(out) != 0) {
+        result = 1;
+    }
+    return result;
+}
+
+#ifdef FF_STATS
+// Print one latency or length histogram of the hot-path statistics
+void print_histogram_line(const char *label, const Histogram *histogram) {
+    printf("- %s: %ld samples, p50 %ld, p90 %ld, p99 %ld, p99.9 %ld, max %ld\n", label, histogram->total,
+           histogram_percentile(histogram, 50), histogram_percentile(histogram, 90),
+           histogram_percentile(histogram, 99), histogram_percentile(histogram, 99.9), histogram->max);
+}
+
+// Print the hot-path counters and latency histograms gathered in an FF_STATS build
+void print_hot_path_stats(SystemMemory *sys) {
+    const HotPathStats *stats = &sys->stats;
+    long scanned = stats->blocks_scanned + sys->free_index.visits;
+    long attempts = stats->scan_lengths.total;
+    printf("Hot-Path Statistics:\n");
+    printf("- Placement attempts: %ld, blocks and index nodes scanned %ld (%.2f per attempt)\n",
+           attempts, scanned, attempts > 0 ? (double)scanned / attempts : 0.0);
+    printf("- Splits: %ld, merges: %ld\n", stats->splits, sys->merges);
+    printf("- Wait queue: %ld enqueues, %ld dequeues, %ld drains, %ld drain iterations\n",
+           stats->enqueues, stats->dequeues, stats->drains, stats->drain_iterations);
+    print_histogram_line("Scan length (blocks)", &stats->scan_lengths);
+    print_histogram_line("Allocate latency (ns)", &stats->allocate_ns);
+    print_histogram_line("Free latency (ns)", &stats->free_ns);
+    print_histogram_line("Drain latency (ns)", &stats->drain_ns);
+}
+#endif
+
+// Command-line name of a wait policy
+const char *wait_policy_name(WaitPolicy policy) {
+    static const char *const names[] = {"fifo", "first-fit", "smallest", "bypass"};
+    return names[policy];
+}
+
+// Print the end-of-run summary for batch mode
+void print_replay_summary(SystemMemory *sys, const ReplayStats *stats, double seconds) {
+    printf("Trace Replay Summary:\n");
+    printf("- Strategy: %s%s\n", sys->strategy->name,
+           sys->strategy == &FIRST_FIT_LINEAR ? " (linear scan)" :
+           sys->strategy == &FIRST_FIT_SIMD ? " (SIMD scan)" :
+           sys->strategy == &SEGREGATED_FIT ? " (size-class bins)" :
+           sys->strategy == &BUDDY ? " (binary buddy)" : " (indexed)");
+    printf("- Engine: %s%s\n", sys->engine->name,
+           sys->engine->strategy != NULL ? " (specialized at compile time)" : "");
+    printf("- Events: %ld (%ld allocations, %ld frees, %ld compactions)\n",
+           stats->events, stats->allocations, stats->frees, stats->compactions);
+    if (stats->batch > 0) {
+        printf("- Batches: %ld of up to %ld events, one wait-queue drain each\n", stats->batches, stats->batch);
+    }
+    if (sys->departed > 0) {
+        printf("- Simulated time: %ld, %ld departures (%.4f per time unit)\n", sys->clock, sys->departed,
+               sys->clock > 0 ? (double)sys->departed / sys->clock : 0.0);
+    }
+    printf("- Allocations placed immediately: %ld\n", stats->placed);
+    printf("- Frees of unknown processes: %ld\n", stats->not_found);
+    printf("- Elapsed: %.6f s\n", seconds);
+    printf("- Throughput: %.0f events/sec\n", seconds > 0 ? stats->events / seconds : 0.0);
+    printf("- Coalescing: %ld merges, %ld deferred passes\n", sys->merges, sys->coalesce_passes);
+    printf("- Compaction: %ld passes, %ldKB moved, %.6f s, %ld waiters served after compacting\n",
+           sys->compactions, sys->compaction_moved, sys->compaction_seconds, sys->compaction_served);
+    const Histogram *waits = &sys->wait_times;
+    printf("- Wait policy: %s (%ld waiters served ahead of an older one, %ld withdrawn by a free)\n",
+           wait_policy_name(sys->wait_policy), sys->bypasses, sys->withdrawn);
+    printf("- Wait time (simulated time): %ld served, p50 %ld, p90 %ld, p99 %ld, max %ld\n",
+           waits->total, histogram_percentile(waits, 50), histogram_percentile(waits, 90),
+           histogram_percentile(waits, 99), waits->max);
+    printf("- Final state: %d blocks, %" PRIkb "KB free, %d active processes, %d waiting\n",
+           sys->num_blocks, get_total_free_memory(sys), sys->num_processes, sys->wait_queue_count);
+    printf("- Free space: %d free blocks, largest %" PRIkb "KB\n", get_free_block_count(sys),
+           get_largest_free_block(sys));
+    printf("- Peak block count: %d\n", sys->peak_blocks);
+    printf("- External fragmentation: %.2f%% (1 - largest free / total free)\n",
+           100.0 * external_fragmentation(sys));
+    kb_t allocated = sys->total_memory - get_total_free_memory(sys);
+    printf("- Internal fragmentation: %ldKB of %" PRIkb "KB allocated (%.2f%%)\n",
+           sys->internal_fragmentation, allocated,
+           allocated > 0 ? 100.0 * sys->internal_fragmentation / allocated : 0.0);
+    long reserved, peak_used;
+    metadata_footprint(sys, &reserved, &peak_used);
+    printf("- Metadata: %ldKB reserved (peak), %ldKB of slots used at peak\n",
+           (reserved + 1023) / 1024, (peak_used + 1023) / 1024);
+#ifdef FF_STATS
+    print_hot_path_stats(sys);
+#endif
+}
+
+// Highest id held by an active or waiting process (0 if there are none)
+int highest_process_id(const SystemMemory *sys) {
+    int highest = 0;
+    for (int i = 0; i < sys->processes_used; i++) {
+        if (sys->processes[i].is_active && sys->processes[i].id > highest) {
+            highest = sys->processes[i].id;
+        }
+    }
+    for (int w = sys->wait_queue_front; w >= 0; w = sys->wait_queue[w].next) {
+        if (sys->wait_queue[w].process_id > highest) {
+            highest = sys->wait_queue[w].process_id;
+        }
+    }
+    return highest;
+}
+
+// Run the simulator non-interactively over a trace file ("-" reads stdin), or over a
+// generated workload when `workload` is given; `metrics` (may be NULL) adds a time series
+// and `snapshot` (may be NULL) starts the run from a saved state or saves the final one;
+// `batch` groups that many events per wait-queue drain (0 drains after every event), and
+// `telemetry` (may be NULL) reports the run's progress in the background while it replays
+int run_batch(const char *trace_path, const WorkloadConfig *workload, const char *block_list,
+              const MemoryConfig *config, const MetricsOptions *metrics, const SnapshotOptions *snapshot,
+              long batch, const TelemetryOptions *telemetry) {
+    SystemMemory system_memory;
+    kb_t *block_sizes = NULL;
+    const char *restore_path = snapshot != NULL ? snapshot->restore_path : NULL;
+
+    int num_blocks = restore_path != NULL ? 0 : parse_block_list(block_list, &block_sizes);
+    if (restore_path == NULL && num_blocks < 1) {
+        fprintf(stderr, "Invalid block list '%s' (expected sizes such as 100,500,200)\n", block_list);
+        free(block_sizes);
+        return 1;
+    }
+
+    // Binary traces are replayed straight from the mapping; anything else is read as text
+    FILE *in = workload != NULL ? NULL : stdin;
+    size_t map_length = 0;
+    const TraceHeader *header = in != NULL && strcmp(trace_path, "-") != 0 ?
+                                map_binary_trace(trace_path, &map_length) : NULL;
+    if (header != NULL) {
+        if (header->version != TRACE_VERSION || header->record_size != sizeof(TraceRecord) ||
+            (map_length - sizeof(TraceHeader)) % sizeof(TraceRecord) != 0) {
+            fprintf(stderr, "%s: unsupported binary trace version or truncated file\n", trace_path);
+            munmap((void *)header, map_length);
+            free(block_sizes);
+            return 1;
+        }
+        in = NULL;
+    } else if (in != NULL && strcmp(trace_path, "-") != 0) {
+        in = fopen(trace_path, "r");
+        if (in == NULL) {
+            perror(trace_path);
+            free(block_sizes);
+            return 1;
+        }
+    }
+
+    int init_result;
+    if (restore_path != NULL) {
+        init_result = restore_snapshot(&system_memory, restore_path);
+    } else {
+        init_result = initialize_memory(&system_memory, num_blocks, block_sizes, config);
+        if (init_result != 0) {
+            fprintf(stderr, "Could not allocate simulator tables\n");
+        }
+    }
+    free(block_sizes);
+    if (init_result != 0) {
+        if (header != NULL) {
+            munmap((void *)header, map_length);
+        } else if (in != NULL && in != stdin) {
+            fclose(in);
+        }
+        return 1;
+    }
+
+    ReplayStats stats = {0};
+    stats.batch = batch;
+    stats.keep_departures = snapshot != NULL && snapshot->save_path != NULL;
+    MetricsSampler sampler;
+    if (metrics != NULL && metrics_open(&sampler, metrics) == 0) {
+        stats.metrics = &sampler;
+    }
+    TelemetryReporter reporter;
+    if (telemetry != NULL) {
+        stats.telemetry = telemetry_start(&reporter, telemetry, 1);
+    }
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int result;
+    if (workload != NULL) {
+        WorkloadGenerator gen;
+        workload_init(&gen, workload, system_memory.total_memory);
+        // Processes carried over from a snapshot keep their memory; new ones get fresh ids
+        gen.next_pid = highest_process_id(&system_memory) + 1;
+        result = replay_workload(&system_memory, &gen, &stats);
+        workload_destroy(&gen);
+    } else if (header != NULL) {
+        long count = (long)((map_length - sizeof(TraceHeader)) / sizeof(TraceRecord));
+        result = replay_binary_trace(&system_memory, (const TraceRecord *)(header + 1), count, &stats);
+    } else {
+        result = replay_trace(&system_memory, in, &stats);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (stats.telemetry != NULL) {
+        telemetry_stop(&reporter);
+        stats.telemetry = NULL;
+    }
+
+    if (header != NULL) {
+        munmap((void *)header, map_length);
+    } else if (in != NULL && in != stdin) {
+        fclose(in);
+    }
+
+    if (stats.metrics != NULL && metrics_close(&sampler) != 0) {
+        fprintf(stderr, "Could not write metrics to %s\n", metrics->path);
+        result = -1;
+    }
+    print_replay_summary(&system_memory, &stats, elapsed_seconds(&start, &end));
+    if (snapshot != NULL && snapshot->save_path != NULL && save_snapshot(&system_memory, snapshot->save_path) != 0) {
+        result = -1;
+    }
+    destroy_memory(&system_memory);
+    return result == 0 ? 0 : 1;
+}
+
+// A trace held in memory and shared read-only by every job of a sweep
+typedef struct {
+    const char *path;               // Trace file, or NULL for the generated workload
+    const TraceRecord *records;     // First event
+    long count;                     // Number of events
+    void *map;                      // Mapping of a binary trace (NULL: records are on the heap)
+    size_t map_length;              // Length of the mapping
+} SweepTrace;
+
+// One simulator configuration of a parameter sweep, with its results once it has run
+typedef struct {
+    char *spec;                     // The sweep-file line, echoed in the results
+    char *buffer;                   // Tokenized copy of the line that the options point into
+    const char *block_list;         // Initial block sizes
+    const char *trace_path;         // Trace to replay (NULL: the shared default trace)
+    const char *snapshot_path;      // Saved state to start from instead of block_list (NULL: none)
+    MemoryConfig config;            // Simulator configuration
+    kb_t *size_classes;             // Size classes set by this job (owned)
+    const SweepTrace *trace;        // Events to replay
+    ReplayStats stats;              // Replay counters
+    double seconds;                 // Replay CPU time
+    double external_fragmentation;  // External fragmentation at the end
+    double internal_fragmentation;  // Internal fragmentation at the end, as a share of allocated KB
+    int waiting;                    // Processes still waiting at the end
+    int peak_blocks;                // Highest number of memory blocks
+    long wait_p99;                  // 99th percentile wait time in simulated time
+    long metadata_bytes;            // Metadata tables reserved by the worker at the end of the job
+    int failed;                     // Set when the job could not run or hit a malformed event
+} SweepJob;
+
+// Work list of the sweep thread pool
+typedef struct {
+    SweepJob *jobs;                 // Jobs to run
+    int count;                      // Number of jobs
+    int next;                       // Next job to hand out
+    pthread_mutex_t lock;           // Guards next and next_slot
+    TelemetrySlot *slots;           // One telemetry slot per worker (NULL: no telemetry)
+    int next_slot;                  // Next slot to hand to a starting worker
+} SweepPool;
+
+// Load a trace once for a sweep: binary traces stay mapped, text traces are parsed into records
+// Returns 0 on success, -1 if the file cannot be read or contains a malformed line
+int load_sweep_trace(SweepTrace *trace, const char *path) {
+    memset(trace, 0, sizeof(SweepTrace));
+    trace->path = path;
+    const TraceHeader *header = map_binary_trace(path, &trace->map_length);
+    if (header != NULL) {
+        if (header->version != TRACE_VERSION || header->record_size != sizeof(TraceRecord) ||
+            (trace->map_length - sizeof(TraceHeader)) % sizeof(TraceRecord) != 0) {
+            fprintf(stderr, "%s: unsupported binary trace version or truncated file\n", path);
+            munmap((void *)header, trace->map_length);
+            return -1;
+        }
+        trace->map = (void *)header;
+        trace->records = (const TraceRecord *)(header + 1);
+        trace->count = (long)((trace->map_length - sizeof(TraceHeader)) / sizeof(TraceRecord));
+        return 0;
+    }
+
+    FILE *in = fopen(path, "r");
+    if (in == NULL) {
+        perror(path);
+        return -1;
+    }
+    TraceRecord *records = NULL;
+    int capacity = 0, count = 0;
+    char line[256];
+    long line_number = 0;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        line_number++;
+        TraceRecord record;
+        int parsed = parse_trace_line(line, &record);
+        if (parsed < 0) {
+            fprintf(stderr, "%s: malformed trace event on line %ld: %s", path, line_number, line);
+            break;
+        }
+        if (parsed > 0) {
+            if (ensure_capacity((void **)&records, &capacity, count + 1, sizeof(TraceRecord)) != 0) {
+                fprintf(stderr, "%s: could not hold the trace in memory\n", path);
+                break;
+            }
+            records[count++] = record;
+        }
+    }
+    int complete = feof(in);
+    fclose(in);
+    if (!complete) {
+        free(records);
+        return -1;
+    }
+    trace->records = records;
+    trace->count = count;
+    return 0;
+}
+
+// Generate a workload once so that every job of a sweep replays the same events
+// Returns 0 on success, -1 if the generator or the record array ran out of memory
+int generate_sweep_trace(SweepTrace *trace, const WorkloadConfig *workload, kb_t total_memory) {
+    memset(trace, 0, sizeof(SweepTrace));
+    TraceRecord *records = malloc((size_t)workload->events * sizeof(TraceRecord));
+    if (records == NULL) {
+        fprintf(stderr, "Could not hold %ld generated events in memory\n", workload->events);
+        return -1;
+    }
+    WorkloadGenerator gen;
+    workload_init(&gen, workload, total_memory);
+    while (workload_next(&gen, &records[trace->count])) {
+        trace->count++;
+    }
+    workload_destroy(&gen);
+    trace->records = records;
+    return trace->count == workload->events ? 0 : -1;
+}
+
+// Release a shared sweep trace
+void destroy_sweep_trace(SweepTrace *trace) {
+    if (trace->map != NULL) {
+        munmap(trace->map, trace->map_length);
+    } else {
+        free((void *)trace->records);
+    }
+}
+
+// Index of `name` in a table of option names, or -1 if it is not there
+int find_option_name(const char *name, const char *const names[], int count) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(name, names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Parse one sweep-file line of KEY=VALUE options over the command-line defaults
+// Keys: blocks, trace, snapshot, strategy, index, coalesce, wait-policy, max-bypass, compact,
+// size-classes, batch. A job started from a snapshot takes its blocks and options from the snapshot.
+// Returns 1 for a job, 0 for a blank or comment line, or -1 for an invalid option
+int parse_sweep_job(const char *line, SweepJob *job, const SweepJob *defaults, const char *strategy_name,
+                    int use_index) {
+    static const char *const coalesce_names[] = {"immediate", "deferred", "never"};
+    static const char *const wait_names[] = {"fifo", "first-fit", "smallest", "bypass"};
+    static const char *const index_names[] = {"linear", "tree", "simd"};
+    static const char *const compact_names[] = {"manual", "on-stall"};
+
+    size_t length = strcspn(line, "\r\n");
+    size_t skip = strspn(line, " \t");
+    if (skip >= length || line[skip] == '#') {
+        return 0;
+    }
+    *job = *defaults;
+    job->spec = strndup(line + skip, length - skip);
+    job->buffer = strdup(job->spec);
+    if (job->spec == NULL || job->buffer == NULL) {
+        fprintf(stderr, "Could not allocate a sweep job\n");
+        return -1;
+    }
+
+    char *save;
+    for (char *token = strtok_r(job->buffer, " \t", &save); token != NULL; token = strtok_r(NULL, " \t", &save)) {
+        char *value = strchr(token, '=');
+        if (value == NULL) {
+            fprintf(stderr, "Sweep option '%s' is not KEY=VALUE\n", token);
+            return -1;
+        }
+        *value++ = '\0';
+        int choice = 0;
+        long count = 0;
+        if (strcmp(token, "blocks") == 0) {
+            job->block_list = value;
+        } else if (strcmp(token, "trace") == 0) {
+            job->trace_path = value;
+        } else if (strcmp(token, "snapshot") == 0) {
+            job->snapshot_path = value;
+        } else if (strcmp(token, "strategy") == 0) {
+            strategy_name = value;
+        } else if (strcmp(token, "index") == 0 && (choice = find_option_name(value, index_names, 3)) >= 0) {
+            use_index = choice;
+        } else if (strcmp(token, "coalesce") == 0 &&
+                   (choice = find_option_name(value, coalesce_names, 3)) >= 0) {
+            job->config.coalesce = (CoalescePolicy)choice;
+        } else if (strcmp(token, "wait-policy") == 0 &&
+                   (choice = find_option_name(value, wait_names, 4)) >= 0) {
+            job->config.wait_policy = (WaitPolicy)choice;
+        } else if (strcmp(token, "max-bypass") == 0 && parse_count(value, INT_MAX, &count) == 0) {
+            job->config.max_bypass = (int)count;
+        } else if (strcmp(token, "compact") == 0 && (choice = find_option_name(value, compact_names, 2)) >= 0) {
+            job->config.compact_on_stall = choice;
+        } else if (strcmp(token, "batch") == 0 && parse_count(value, LONG_MAX, &count) == 0) {
+            job->stats.batch = count;
+        } else if (strcmp(token, "size-classes") == 0) {
+            free(job->size_classes);
+            job->config.num_size_classes = parse_size_classes(value, &job->size_classes);
+            job->config.size_classes = job->size_classes;
+            if (job->config.num_size_classes < 0) {
+                fprintf(stderr, "Sweep size-classes expects 1 to %d strictly increasing sizes\n",
+                        MAX_SIZE_CLASSES - 1);
+                return -1;
+            }
+        } else {
+            fprintf(stderr, "Unknown sweep option or value '%s=%s'\n", token, value);
+            return -1;
+        }
+    }
+
+    job->config.strategy = find_strategy(strategy_name, use_index);
+    if (job->config.strategy == NULL) {
+        fprintf(stderr, "Unknown strategy '%s' in sweep job '%s'\n", strategy_name, job->spec);
+        return -1;
+    }
+    if (job->block_list == NULL && job->snapshot_path == NULL) {
+        fprintf(stderr, "Sweep job '%s' has no blocks (set blocks=, snapshot= or --blocks)\n", job->spec);
+        return -1;
+    }
+    return 1;
+}
+
+// Read every job of a sweep file
+// Returns the number of jobs, or -1 if the file cannot be read or has an invalid line
+int load_sweep_jobs(const char *path, SweepJob **jobs, const SweepJob *defaults, const char *strategy_name,
+                    int use_index) {
+    FILE *in = fopen(path, "r");
+    if (in == NULL) {
+        perror(path);
+        return -1;
+    }
+    *jobs = NULL;
+    int capacity = 0, count = 0;
+    char line[1024];
+    int parsed = 0;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        if (ensure_capacity((void **)jobs, &capacity, count + 1, sizeof(SweepJob)) != 0) {
+            parsed = -1;
+            break;
+        }
+        memset(&(*jobs)[count], 0, sizeof(SweepJob));
+        parsed = parse_sweep_job(line, &(*jobs)[count], defaults, strategy_name, use_index);
+        if (parsed < 0) {
+            count++;
+            break;
+        }
+        count += parsed;
+    }
+    fclose(in);
+    if (parsed < 0) {
+        for (int i = 0; i < count; i++) {
+            free((*jobs)[i].spec);
+            free((*jobs)[i].buffer);
+            free((*jobs)[i].size_classes);
+        }
+        free(*jobs);
+        return -1;
+    }
+    return count;
+}
+
+// Replay one sweep job on the worker's memory system and keep its results. The system is
+// reset in bulk between jobs (`*ready` is set once it holds tables), so a worker's later
+// jobs reuse the metadata tables of its earlier ones.
+void run_sweep_job(SweepJob *job, SystemMemory *sys, int *ready) {
+    int init_result;
+    if (job->snapshot_path != NULL) {
+        // A restored system brings its own tables
+        if (*ready) {
+            destroy_memory(sys);
+        }
+        init_result = restore_snapshot(sys, job->snapshot_path);
+    } else {
+        kb_t *block_sizes;
+        int num_blocks = parse_block_list(job->block_list, &block_sizes);
+        if (num_blocks < 1) {
+            fprintf(stderr, "Sweep job '%s': invalid block list '%s'\n", job->spec, job->block_list);
+            free(block_sizes);
+            job->failed = 1;
+            return;
+        }
+        init_result = *ready ? reset_memory(sys, num_blocks, block_sizes, &job->config) :
+                               initialize_memory(sys, num_blocks, block_sizes, &job->config);
+        free(block_sizes);
+    }
+    *ready = init_result == 0;
+    if (init_result != 0) {
+        fprintf(stderr, "Sweep job '%s': could not set up the memory system\n", job->spec);
+        job->failed = 1;
+        return;
+    }
+
+    // Time the job on its thread's CPU clock, so workers sharing a core don't inflate it
+    struct timespec start, end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    job->failed = replay_binary_trace(sys, job->trace->records, job->trace->count, &job->stats) != 0;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+    job->seconds = elapsed_seconds(&start, &end);
+
+    kb_t allocated = sys->total_memory - get_total_free_memory(sys);
+    long peak_used;
+    job->external_fragmentation = external_fragmentation(sys);
+    job->internal_fragmentation = allocated > 0 ? (double)sys->internal_fragmentation / allocated : 0.0;
+    job->waiting = sys->wait_queue_count;
+    job->peak_blocks = sys->peak_blocks;
+    job->wait_p99 = histogram_percentile(&sys->wait_times, 99);
+    metadata_footprint(sys, &job->metadata_bytes, &peak_used);
+}
+
+// Sweep worker thread: run jobs until the work list is empty, on one reused memory system
+void *sweep_worker(void *arg) {
+    SweepPool *pool = arg;
+    SystemMemory sys;
+    int ready = 0;
+    pthread_mutex_lock(&pool->lock);
+    TelemetrySlot *slot = pool->slots != NULL ? &pool->slots[pool->next_slot++] : NULL;
+    pthread_mutex_unlock(&pool->lock);
+    while (1) {
+        pthread_mutex_lock(&pool->lock);
+        int index = pool->next < pool->count ? pool->next++ : -1;
+        pthread_mutex_unlock(&pool->lock);
+        if (index < 0) {
+            break;
+        }
+        SweepJob *job = &pool->jobs[index];
+        if (slot != NULL) {
+            telemetry_set_job(slot, index + 1, 0);
+            job->stats.telemetry = slot;
+        }
+        run_sweep_job(job, &sys, &ready);
+        if (slot != NULL) {
+            telemetry_set_job(slot, 0, job->stats.events);
+            job->stats.telemetry = NULL;
+        }
+    }
+    if (ready) {
+        destroy_memory(&sys);
+    }
+    return NULL;
+}
+
+// Print the per-job results of a sweep and their totals
+void print_sweep_summary(const SweepJob *jobs, int count, int threads, double wall_seconds) {
+    long events = 0;
+    double busy_seconds = 0;
+    int failed = 0;
+    printf("Sweep Summary (%d jobs on %d threads):\n", count, threads);
+    printf("%4s %10s %10s %8s %8s %8s %7s %9s %8s %12s  %s\n", "job", "events", "placed", "waiting",
+           "ext-frag", "int-frag", "blocks", "wait-p99", "meta-KB", "events/sec", "config");
+    for (int i = 0; i < count; i++) {
+        const SweepJob *job = &jobs[i];
+        if (job->failed) {
+            printf("%4d %10s  %s\n", i + 1, "failed", job->spec);
+            failed++;
+            continue;
+        }
+        printf("%4d %10ld %10ld %8d %7.2f%% %7.2f%% %7d %9ld %8ld %12.0f  %s\n", i + 1, job->stats.events,
+               job->stats.placed, job->waiting, 100.0 * job->external_fragmentation,
+               100.0 * job->internal_fragmentation, job->peak_blocks, job->wait_p99,
+               (job->metadata_bytes + 1023) / 1024,
+               job->seconds > 0 ? job->stats.events / job->seconds : 0.0, job->spec);
+        events += job->stats.events;
+        busy_seconds += job->seconds;
+    }
+    printf("- Jobs: %d completed, %d failed\n", count - failed, failed);
+    printf("- Events: %ld in %.6f s wall, %.6f s of worker CPU time\n", events, wall_seconds, busy_seconds);
+    printf("- Throughput: %.0f events/sec (%.2fx speedup over running the jobs back to back)\n",
+           wall_seconds > 0 ? events / wall_seconds : 0.0, wall_seconds > 0 ? busy_seconds / wall_seconds : 0.0);
+}
+
+// Run every configuration of a sweep file on a pool of `threads` workers
+// Each job gets its own memory system; all of them replay shared, read-only trace buffers.
+// With `telemetry` (may be NULL) every worker reports its progress under its own label.
+int run_sweep(const char *sweep_path, int threads, const char *trace_path, const WorkloadConfig *workload,
+              const char *block_list, const MemoryConfig *config, const char *strategy_name, int use_index,
+              long batch, const TelemetryOptions *telemetry) {
+    SweepJob defaults = {0};
+    defaults.block_list = block_list;
+    defaults.config = *config;
+    defaults.stats.batch = batch;
+    SweepJob *jobs;
+    int count = load_sweep_jobs(sweep_path, &jobs, &defaults, strategy_name, use_index);
+    if (count < 1) {
+        if (count == 0) {
+            fprintf(stderr, "%s: no sweep jobs\n", sweep_path);
+            free(jobs);
+        }
+        return 1;
+    }
+
+    // Load each distinct trace once; jobs without trace= share the command-line trace
+    SweepTrace *traces = calloc((size_t)count + 1, sizeof(SweepTrace));
+    int num_traces = 0;
+    int result = traces == NULL;
+    for (int i = 0; i < count && result == 0; i++) {
+        SweepJob *job = &jobs[i];
+        const char *path = job->trace_path != NULL ? job->trace_path : trace_path;
+        if (path == NULL && workload == NULL) {
+            fprintf(stderr, "Sweep job '%s' has no trace (set trace=, --trace or --generate)\n", job->spec);
+            result = 1;
+            break;
+        }
+        if (path == NULL && job->snapshot_path != NULL) {
+            // Generated process ids would collide with the processes saved in the snapshot
+            fprintf(stderr, "Sweep job '%s' starts from a snapshot and needs a trace file (set trace= "
+                    "or --trace)\n", job->spec);
+            result = 1;
+            break;
+        }
+        int t = 0;
+        while (t < num_traces && !(path == NULL ? traces[t].path == NULL :
+                                   traces[t].path != NULL && strcmp(traces[t].path, path) == 0)) {
+            t++;
+        }
+        if (t == num_traces) {
+            if (path != NULL) {
+                result = load_sweep_trace(&traces[t], path) != 0;
+            } else {
+                // The generator sizes its occupancy target for the first job's memory
+                kb_t *block_sizes;
+                kb_t total_memory = 0;
+                int num_blocks = parse_block_list(job->block_list, &block_sizes);
+                for (int b = 0; b < num_blocks; b++) {
+                    total_memory += block_sizes[b];
+                }
+                free(block_sizes);
+                result = generate_sweep_trace(&traces[t], workload,
+                                              total_memory) != 0;
+            }
+            if (result != 0) {
+                break;
+            }
+            num_traces++;
+        }
+        job->trace = &traces[t];
+    }
+
+    if (result == 0) {
+        if (threads > count) {
+            threads = count;
+        }
+        SweepPool pool = {jobs, count, 0, PTHREAD_MUTEX_INITIALIZER, NULL, 0};
+        TelemetryReporter reporter;
+        if (telemetry != NULL) {
+            pool.slots = telemetry_start(&reporter, telemetry, threads);
+        }
+        pthread_t *workers = malloc((size_t)threads * sizeof(pthread_t));
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        int started = 0;
+        while (workers != NULL && started < threads &&
+               pthread_create(&workers[started], NULL, sweep_worker, &pool) == 0) {
+            started++;
+        }
+        if (started == 0) {
+            // No threads available: run the jobs on this one
+            sweep_worker(&pool);
+            started = 1;
+        } else {
+            for (int i = 0; i < started; i++) {
+                pthread_join(workers[i], NULL);
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        if (pool.slots != NULL) {
+            telemetry_stop(&reporter);
+        }
+        free(workers);
+        print_sweep_summary(jobs, count, started, elapsed_seconds(&start, &end));
+        for (int i = 0; i < count; i++) {
+            result |= jobs[i].failed;
+        }
+    }
+
+    for (int t = 0; t < num_traces; t++) {
+        destroy_sweep_trace(&traces[t]);
+    }
+    free(traces);
+    for (int i = 0; i < count; i++) {
+        free(jobs[i].spec);
+        free(jobs[i].buffer);
+        free(jobs[i].size_classes);
+    }
+    free(jobs);
+    return result == 0 ? 0 : 1;
+}
+
+// Compare a checked memory system with the reference one: the block lists, every active
+// process's placement and the wait queue in arrival order
+// Returns 0 if they agree, or -1 after describing the first difference in `why`
+int compare_systems(SystemMemory *reference, SystemMemory *checked, char *why, size_t length) {
+    int number = 1;
+    int r = reference->first_block, c = checked->first_block;
+    for (; r >= 0 && c >= 0; r = reference->blocks[r].next, c = checked->blocks[c].next, number++) {
+        const MemoryBlock *a = &reference->blocks[r], *b = &checked->blocks[c];
+        if (a->start != b->start || a->size != b->size || a->is_free != b->is_free) {
+            snprintf(why, length, "block %d is %" PRIkb "KB %s at %" PRIkb " in the reference but %" PRIkb
+                     "KB %s at %" PRIkb, number, a->size, a->is_free ? "free" : "allocated", a->start, b->size,
+                     b->is_free ? "free" : "allocated", b->start);
+            return -1;
+        }
+    }
+    if (r >= 0 || c >= 0) {
+        snprintf(why, length, "the reference has %d blocks but the checked engine has %d",
+                 reference->num_blocks, checked->num_blocks);
+        return -1;
+    }
+
+    if (reference->num_processes != checked->num_processes) {
+        snprintf(why, length, "%d active processes in the reference but %d", reference->num_processes,
+                 checked->num_processes);
+        return -1;
+    }
+    for (int i = 0; i < reference->processes_used; i++) {
+        const Process *a = &reference->processes[i];
+        if (!a->is_active) {
+            continue;
+        }
+        int slot = process_map_find(&checked->process_map, a->id);
+        if (slot < 0 || checked->processes[slot].memory_address != a->memory_address) {
+            snprintf(why, length, "process %d is at %" PRIkb " in the reference but %s", a->id,
+                     a->memory_address, slot < 0 ? "not placed" : "elsewhere");
+            return -1;
+        }
+    }
+
+    number = 1;
+    r = reference->wait_queue_front;
+    c = checked->wait_queue_front;
+    for (; r >= 0 && c >= 0; r = reference->wait_queue[r].next, c = checked->wait_queue[c].next, number++) {
+        const WaitingProcess *a = &reference->wait_queue[r], *b = &checked->wait_queue[c];
+        if (a->process_id != b->process_id || a->memory_size != b->memory_size) {
+            snprintf(why, length, "waiter %d is process %d for %" PRIkb "KB in the reference but process %d for %"
+                     PRIkb "KB", number, a->process_id, a->memory_size, b->process_id, b->memory_size);
+            return -1;
+        }
+    }
+    if (r >= 0 || c >= 0) {
+        snprintf(why, length, "%d processes wait in the reference but %d", reference->wait_queue_count,
+                 checked->wait_queue_count);
+        return -1;
+    }
+    return 0;
+}
+
+// Result of a lockstep replay
+typedef struct {
+    long events;            // Events replayed through both systems
+    long comparisons;       // Full state comparisons made
+    double compare_seconds; // Time spent comparing state
+    long diverged;          // Index of the event after which the systems were seen to differ (-1: never)
+    char why[256];          // Description of the difference
+} LockstepResult;
+
+// Replay records through the reference engine (first fit by linear scan on the generic
+// engine) and the checked engine side by side. Allocation addresses are compared after
+// every event; the whole state every `interval` events, after every event from index
+// `dense_from` on, and once more after the trace. Both systems use `config` otherwise.
+// Returns 0 on success, -1 if a system could not be set up or a record is malformed
+int lockstep_replay(const TraceRecord *records, long count, int num_blocks, const kb_t block_sizes[],
+                    const MemoryConfig *config, long batch, long interval, long dense_from,
+                    LockstepResult *result) {
+    SystemMemory reference, checked;
+    MemoryConfig reference_config = *config;
+    reference_config.strategy = &FIRST_FIT_LINEAR;
+    memset(result, 0, sizeof(LockstepResult));
+    result->diverged = -1;
+    if (initialize_memory(&reference, num_blocks, block_sizes, &reference_config) != 0) {
+        return -1;
+    }
+    if (initialize_memory(&checked, num_blocks, block_sizes, config) != 0) {
+        destroy_memory(&reference);
+        return -1;
+    }
+    reference.engine = &GENERIC_ENGINE;
+    ReplayStats reference_stats = {0}, checked_stats = {0};
+    reference_stats.batch = checked_stats.batch = batch;
+
+    int failed = 0;
+    for (long i = 0; i <= count && result->diverged < 0; i++) {
+        if (i == count) {
+            // Let the departures still scheduled run out, then compare the final states
+            finish_replay(&reference, &reference_stats);
+            finish_replay(&checked, &checked_stats);
+        } else {
+            const TraceRecord *record = &records[i];
+            if (apply_trace_record(&reference, record, &reference_stats) != 0 ||
+                apply_trace_record(&checked, record, &checked_stats) != 0) {
+                fprintf(stderr, "Malformed trace record %ld (op 0x%02x)\n", i, record->op);
+                failed = 1;
+                break;
+            }
+            result->events++;
+            if (record->op == 'a' && reference_stats.last_address != checked_stats.last_address) {
+                snprintf(result->why, sizeof(result->why), "process %d (%dKB) was %s%" PRIkb " by the "
+                         "reference but %s%" PRIkb, record->process_id, record->size,
+                         reference_stats.last_address == -1 ? "queued " : "placed at ",
+                         reference_stats.last_address == -1 ? 0 : reference_stats.last_address,
+                         checked_stats.last_address == -1 ? "queued " : "placed at ",
+                         checked_stats.last_address == -1 ? 0 : checked_stats.last_address);
+                result->diverged = i;
+                break;
+            }
+            if (i < dense_from && (i + 1) % interval != 0) {
+                continue;
+            }
+        }
+        double start = monotonic_ns();
+        if (compare_systems(&reference, &checked, result->why, sizeof(result->why)) != 0) {
+            result->diverged = i;
+        }
+        result->compare_seconds += (monotonic_ns() - start) / 1e9;
+        result->comparisons++;
+    }
+    destroy_memory(&reference);
+    destroy_memory(&checked);
+    return failed ? -1 : 0;
+}
+
+// Command-line name of a first-fit engine's index mode
+const char *index_mode_name(const PlacementStrategy *strategy) {
+    return strategy == &FIRST_FIT_SIMD ? "simd" : strategy == &FIRST_FIT_INDEXED ? "tree" : "linear";
+}
+
+// Check the configured first-fit engine against the reference linear scan over a trace file
+// or a generated workload, comparing state every `interval` events. At the first divergence
+// the events since the last agreeing comparison are replayed again with a comparison after
+// each one, and the trace up to the first diverging event is written to `repro_path`.
+// Returns 0 if the engines agree, 1 otherwise
+int run_check(const char *trace_path, const WorkloadConfig *workload, const char *block_list,
+              const MemoryConfig *config, long batch, long interval, const char *repro_path) {
+    static const char *const coalesce_names[] = {"immediate", "deferred", "never"};
+    kb_t *block_sizes;
+    int num_blocks = parse_block_list(block_list, &block_sizes);
+    if (num_blocks < 1) {
+        fprintf(stderr, "Invalid block list '%s' (expected sizes such as 100,500,200)\n", block_list);
+        free(block_sizes);
+        return 1;
+    }
+    kb_t total_memory = 0;
+    for (int i = 0; i < num_blocks; i++) {
+        total_memory += block_sizes[i];
+    }
+    SweepTrace trace;
+    if ((trace_path != NULL ? load_sweep_trace(&trace, trace_path) :
+                              generate_sweep_trace(&trace, workload, total_memory)) != 0) {
+        free(block_sizes);
+        return 1;
+    }
+
+    LockstepResult result;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int status = lockstep_replay(trace.records, trace.count, num_blocks, block_sizes, config, batch, interval,
+                                 LONG_MAX, &result);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long first = result.diverged;
+    if (status == 0 && first >= 0) {
+        // Pin down the first diverging event after the last comparison that agreed
+        long agreed = first / interval * interval - 1;
+        LockstepResult dense;
+        if (lockstep_replay(trace.records, first < trace.count ? first + 1 : trace.count, num_blocks,
+                            block_sizes, config, batch, interval, agreed + 1, &dense) == 0 && dense.diverged >= 0) {
+            first = dense.diverged;
+            memcpy(result.why, dense.why, sizeof(result.why));
+        }
+    }
+
+    printf("Lockstep Check Summary:\n");
+    printf("- Reference: first-fit linear scan (generic engine)\n");
+    printf("- Checked: first-fit %s scan (%s engine), %s coalescing, %s wait policy\n",
+           index_mode_name(config->strategy), select_engine(config->strategy, config->coalesce)->name,
+           coalesce_names[config->coalesce], wait_policy_name(config->wait_policy));
+    printf("- Events: %ld, %ld state comparisons (every %ld events)\n", result.events, result.comparisons,
+           interval);
+    printf("- Elapsed: %.6f s, %.6f s of it comparing state\n", elapsed_seconds(&start, &end),
+           result.compare_seconds);
+    if (status == 0 && first < 0) {
+        printf("- Result: the engines agree\n");
+    } else if (status == 0) {
+        long events = first < trace.count ? first + 1 : trace.count;
+        printf("- Result: diverged %s event %ld: %s\n", first < trace.count ? "at" : "after the last",
+               events, result.why);
+        FILE *out = fopen(repro_path, "w");
+        if (out == NULL) {
+            perror(repro_path);
+        } else {
+            fprintf(out, "# Lockstep divergence %s event %ld: %s\n", first < trace.count ? "at" : "after",
+                    events, result.why);
+            fprintf(out, "# ./simulator --check 1 --trace %s --blocks %s --index %s --coalesce %s "
+                    "--wait-policy %s --max-bypass %d --compact %s --batch %ld\n", repro_path, block_list,
+                    index_mode_name(config->strategy), coalesce_names[config->coalesce],
+                    wait_policy_name(config->wait_policy), config->max_bypass,
+                    config->compact_on_stall ? "on-stall" : "manual", batch);
+            for (long i = 0; i < events; i++) {
+                write_trace_record(out, &trace.records[i]);
+            }
+            if (fclose(out) == 0) {
+                printf("- Reproduction: %s (%ld events)\n", repro_path, events);
+            }
+        }
+    }
+    destroy_sweep_trace(&trace);
+    free(block_sizes);
+    return status == 0 && first < 0 ? 0 : 1;
+}
+
+// Central heap shared by the threads of a concurrent run
+typedef struct {
+    SystemMemory sys;               // First-fit memory system behind the lock
+    pthread_mutex_t lock;           // Serializes every operation on sys
+} CentralHeap;
+
+// A worker's record of one of its live processes
+typedef struct {
+    int central_id;                 // Process id of its block in the central heap
+    int size_class;                 // Thread-cache class of the block, or -1 if it bypasses the cache
+    int placed;                     // Set if the central heap placed the block at once
+    int next_free;                  // Next recycled record when this one is free
+} ThreadAllocation;
+
+// One allocator thread: its workload, its cache of small blocks and its counters
+typedef struct {
+    CentralHeap *heap;              // Shared central heap
+    WorkloadConfig workload;        // This thread's share of the workload
+    kb_t total_memory;              // Memory the workload's occupancy target is sized for
+    int index;                      // Thread number
+    int threads;                    // Number of threads in the run
+    long next_central;              // Central process ids handed out so far, modulo the id range
+    ThreadAllocation *allocations;  // Records of the live processes
+    int allocations_capacity;       // Length of the allocations table
+    int free_allocation;            // First recycled record, or -1
+    int allocations_used;           // Records handed out from the end of the table
+    ProcessMap map;                 // Workload process id -> allocation record
+    int cache[THREAD_CACHE_CLASSES][THREAD_CACHE_DEPTH];   // Cached blocks by central id
+    int cached[THREAD_CACHE_CLASSES];                       // Blocks in each cache class
+    long operations;                // Allocations and frees performed
+    long cache_hits;                // Small allocations served from the cache
+    long cache_misses;              // Small allocations that went to the central heap
+    long lock_acquisitions;         // Times the central lock was taken
+    long contended;                 // Acquisitions that found the lock held
+    double lock_wait_ns;            // Time spent blocked on the central lock
+    double seconds;                 // Run time of the thread
+    int failed;                     // Set if the thread ran out of memory for its records
+} ConcurrentWorker;
+
+// Take the central lock, timing the wait only when another thread holds it
+static void central_lock(ConcurrentWorker *worker) {
+    worker->lock_acquisitions++;
+    if (pthread_mutex_trylock(&worker->heap->lock) != 0) {
+        double start = monotonic_ns();
+        pthread_mutex_lock(&worker->heap->lock);
+        worker->lock_wait_ns += monotonic_ns() - start;
+        worker->contended++;
+    }
+    worker->heap->sys.clock++;
+}
+
+// Return every cached block to the central heap; the caller holds the central lock
+static void flush_thread_cache(ConcurrentWorker *worker) {
+    for (int c = 0; c < THREAD_CACHE_CLASSES; c++) {
+        while (worker->cached[c] > 0) {
+            free_memory(&worker->heap->sys, worker->cache[c][--worker->cached[c]]);
+        }
+    }
+}
+
+// Cache class of a request: classes hold power-of-two sizes up to THREAD_CACHE_MAX_KB
+static inline int thread_cache_class(int size) {
+    int size_class = 0;
+    while (size_class < THREAD_CACHE_CLASSES && (1 << size_class) < size) {
+        size_class++;
+    }
+    return size_class < THREAD_CACHE_CLASSES ? size_class : -1;
+}
+
+// Next central process id of a worker; the caller holds the central lock. Ids interleave
+// across threads so that they never collide, and wrap within [1, INT_MAX] on long runs,
+// skipping ids whose process is still placed or waiting.
+static int next_central_id(ConcurrentWorker *worker) {
+    const SystemMemory *sys = &worker->heap->sys;
+    long range = (INT_MAX - worker->index) / worker->threads;
+    int id;
+    do {
+        id = (int)(worker->next_central % range * worker->threads + worker->index + 1);
+        worker->next_central = worker->next_central % range + 1;
+    } while (process_map_find(&sys->process_map, id) >= 0 || process_map_find(&sys->wait_map, id) >= 0);
+    return id;
+}
+
+// Allocate for one workload process, from the cache when a block of its class is there
+// Returns 0 on success, -1 if the worker's records could not grow
+int concurrent_allocate(ConcurrentWorker *worker, int process_id, int size) {
+    int slot = worker->free_allocation;
+    if ((slot < 0 && ensure_capacity((void **)&worker->allocations, &worker->allocations_capacity,
+                                     worker->allocations_used + 1, sizeof(ThreadAllocation)) != 0) ||
+        process_map_reserve(&worker->map) != 0) {
+        return -1;
+    }
+    if (slot >= 0) {
+        worker->free_allocation = worker->allocations[slot].next_free;
+    } else {
+        slot = worker->allocations_used++;
+    }
+
+    ThreadAllocation *allocation = &worker->allocations[slot];
+    allocation->size_class = thread_cache_class(size);
+    if (allocation->size_class >= 0 && worker->cached[allocation->size_class] > 0) {
+        allocation->central_id = worker->cache[allocation->size_class][--worker->cached[allocation->size_class]];
+        allocation->placed = 1;
+        worker->cache_hits++;
+    } else {
+        int request = allocation->size_class >= 0 ? 1 << allocation->size_class : size;
+        worker->cache_misses += allocation->size_class >= 0;
+        central_lock(worker);
+        allocation->central_id = next_central_id(worker);
+        allocation->placed = allocate_memory(&worker->heap->sys, allocation->central_id, request) != -1;
+        if (!allocation->placed) {
+            // Memory parked in the cache may be what the central heap is missing
+            flush_thread_cache(worker);
+        }
+        pthread_mutex_unlock(&worker->heap->lock);
+    }
+    process_map_insert(&worker->map, process_id, slot);
+    worker->operations++;
+    return 0;
+}
+
+// Free one workload process, keeping its block in the cache while its class has room
+void concurrent_free(ConcurrentWorker *worker, int process_id) {
+    int slot = process_map_find(&worker->map, process_id);
+    if (slot < 0) {
+        return;
+    }
+    process_map_remove(&worker->map, process_id);
+    ThreadAllocation *allocation = &worker->allocations[slot];
+    allocation->next_free = worker->free_allocation;
+    worker->free_allocation = slot;
+    worker->operations++;
+
+    int size_class = allocation->size_class;
+    if (size_class >= 0 && allocation->placed && worker->cached[size_class] < THREAD_CACHE_DEPTH) {
+        worker->cache[size_class][worker->cached[size_class]++] = allocation->central_id;
+        return;
+    }
+    central_lock(worker);
+    free_memory(&worker->heap->sys, allocation->central_id);
+    pthread_mutex_unlock(&worker->heap->lock);
+}
+
+// Allocator thread: replay this thread's workload against the shared heap
+void *concurrent_worker(void *arg) {
+    ConcurrentWorker *worker = arg;
+    WorkloadGenerator gen;
+    TraceRecord record;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    workload_init(&gen, &worker->workload, worker->total_memory);
+    while (!worker->failed && workload_next(&gen, &record)) {
+        if (record.op == 'a') {
+            worker->failed = concurrent_allocate(worker, record.process_id, record.size) != 0;
+        } else {
+            concurrent_free(worker, record.process_id);
+        }
+    }
+    worker->failed |= gen.produced != worker->workload.events;
+    workload_destroy(&gen);
+
+    central_lock(worker);
+    flush_thread_cache(worker);
+    pthread_mutex_unlock(&worker->heap->lock);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    worker->seconds = elapsed_seconds(&start, &end);
+    return NULL;
+}
+
+// Run the workload on `threads` threads sharing the central heap, which has been reset for
+// the run, and print one result row
+// Returns the throughput in operations per second, or -1 if the run failed
+double run_concurrent_case(int threads, const WorkloadConfig *workload, CentralHeap *heap,
+                           double single_thread_rate) {
+    ConcurrentWorker *workers = calloc((size_t)threads, sizeof(ConcurrentWorker));
+    pthread_t *ids = malloc((size_t)threads * sizeof(pthread_t));
+    int started = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int t = 0; workers != NULL && ids != NULL && t < threads; t++) {
+        // Each thread gets an equal share of the events and of the occupancy target
+        ConcurrentWorker *worker = &workers[t];
+        worker->heap = heap;
+        worker->workload = *workload;
+        worker->workload.events = workload->events / threads + (t < workload->events % threads);
+        worker->workload.seed = workload->seed + (unsigned long long)t;
+        worker->total_memory = heap->sys.total_memory / threads;
+        worker->index = t;
+        worker->threads = threads;
+        worker->free_allocation = -1;
+        if (pthread_create(&ids[t], NULL, concurrent_worker, worker) != 0) {
+            break;
+        }
+        started++;
+    }
+    for (int t = 0; t < started; t++) {
+        pthread_join(ids[t], NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double wall = elapsed_seconds(&start, &end);
+
+    long operations = 0, hits = 0, misses = 0, acquisitions = 0, contended = 0;
+    double wait_ns = 0, thread_seconds = 0;
+    int failed = started < threads;
+    for (int t = 0; t < started; t++) {
+        ConcurrentWorker *worker = &workers[t];
+        operations += worker->operations;
+        hits += worker->cache_hits;
+        misses += worker->cache_misses;
+        acquisitions += worker->lock_acquisitions;
+        contended += worker->contended;
+        wait_ns += worker->lock_wait_ns;
+        thread_seconds += worker->seconds;
+        failed |= worker->failed;
+        free(worker->allocations);
+        free(worker->map.entries);
+    }
+
+    double rate = wall > 0 ? operations / wall : 0.0;
+    if (failed) {
+        fprintf(stderr, "Concurrent run on %d threads failed\n", threads);
+    } else {
+        printf("%7d %12.0f %7.2fx %9.2f%% %10ld %9.2f%% %9.2f%% %8.2f%% %8d\n", threads, rate,
+               single_thread_rate > 0 ? rate / single_thread_rate : 1.0,
+               hits + misses > 0 ? 100.0 * hits / (hits + misses) : 0.0, acquisitions,
+               acquisitions > 0 ? 100.0 * contended / acquisitions : 0.0,
+               thread_seconds > 0 ? 100.0 * wait_ns / 1e9 / thread_seconds : 0.0,
+               100.0 * external_fragmentation(&heap->sys), heap->sys.wait_queue_count);
+    }
+    free(workers);
+    free(ids);
+    return failed ? -1 : rate;
+}
+
+// Measure how the concurrent allocator scales: run the workload on 1, 2, 4, ... up to
+// `max_threads` threads, each with a private cache in front of the locked central heap
+int run_concurrent(int max_threads, const WorkloadConfig *workload, const char *block_list,
+                   const MemoryConfig *config) {
+    kb_t *block_sizes;
+    int num_blocks = parse_block_list(block_list, &block_sizes);
+    if (num_blocks < 1) {
+        fprintf(stderr, "Invalid block list '%s' (expected sizes such as 100,500,200)\n", block_list);
+        free(block_sizes);
+        return 1;
+    }
+
+    printf("Concurrent Scaling (%ld events per run, %s central heap, thread caches of %d blocks\n"
+           "per class up to %dKB):\n", workload->events, config->strategy->name, THREAD_CACHE_DEPTH,
+           1 << (THREAD_CACHE_CLASSES - 1));
+    printf("%7s %12s %8s %10s %10s %10s %10s %9s %8s\n", "threads", "ops/sec", "speedup", "cache-hit",
+           "lock-acq", "contended", "lock-wait", "ext-frag", "waiting");
+    // One central heap serves every run; a bulk reset between runs keeps its tables
+    CentralHeap heap;
+    if (initialize_memory(&heap.sys, num_blocks, block_sizes, config) != 0) {
+        fprintf(stderr, "Could not allocate simulator tables\n");
+        free(block_sizes);
+        return 1;
+    }
+    pthread_mutex_init(&heap.lock, NULL);
+    double single_thread_rate = 0;
+    int result = 0;
+    int threads = 1;
+    while (result == 0) {
+        if (threads > 1 && reset_memory(&heap.sys, num_blocks, block_sizes, config) != 0) {
+            fprintf(stderr, "Could not allocate simulator tables\n");
+            pthread_mutex_destroy(&heap.lock);
+            free(block_sizes);
+            return 1;
+        }
+        double rate = run_concurrent_case(threads, workload, &heap, single_thread_rate);
+        if (rate < 0) {
+            result = 1;
+        } else if (threads == 1) {
+            single_thread_rate = rate;
+        }
+        if (threads == max_threads) {
+            break;
+        }
+        threads = threads * 2 < max_threads ? threads * 2 : max_threads;
+    }
+    pthread_mutex_destroy(&heap.lock);
+    destroy_memory(&heap.sys);
+    free(block_sizes);
+    return result;
+}
+
+// Outcome of one benchmark scenario run against one engine
+typedef struct {
+    long alloc_ops;                 // Number of allocation requests
+    double alloc_ns;                // Time spent in allocation requests, in nanoseconds
+    long free_ops;                  // Number of free requests
+    double free_ns;                 // Time spent in free requests, in nanoseconds
+    long frag_samples;              // Number of external fragmentation samples taken
+    double frag_sum;                // Sum of the sampled external fragmentation ratios
+    double final_fragmentation;     // External fragmentation at the end of the run
+    double internal_fragmentation;  // Internal fragmentation at the end, as a share of allocated KB
+    int peak_blocks;                // Highest number of memory blocks
+    int waiting;                    // Processes still waiting at the end
+    long peak_rss_kb;               // Peak resident set size of the run
+    long metadata_kb;               // Peak simulator metadata reserved by the run
+} BenchResult;
+
+// A fixed benchmark workload
+typedef struct {
+    const char *name;                                           // Name in the results
+    void (*run)(SystemMemory *sys, BenchResult *result);       // Drive the system
+} BenchScenario;
+
+// Timed allocation request; samples external fragmentation every BENCH_SAMPLE_INTERVAL calls
+kb_t bench_allocate(SystemMemory *sys, BenchResult *result, int process_id, kb_t size) {
+    double start = monotonic_ns();
+    kb_t address = allocate_memory(sys, process_id, size);
+    result->alloc_ns += monotonic_ns() - start;
+    if (++result->alloc_ops % BENCH_SAMPLE_INTERVAL == 0) {
+        result->frag_sum += external_fragmentation(sys);
+        result->frag_samples++;
+    }
+    return address;
+}
+
+// Timed free request
+void bench_free(SystemMemory *sys, BenchResult *result, int process_id) {
+    double start = monotonic_ns();
+    free_memory(sys, process_id);
+    result->free_ns += monotonic_ns() - start;
+    result->free_ops++;
+}
+
+// Drive the system with a generated workload
+void bench_workload(SystemMemory *sys, BenchResult *result, const WorkloadConfig *workload) {
+    WorkloadGenerator gen;
+    TraceRecord record;
+    workload_init(&gen, workload, sys->total_memory);
+    while (workload_next(&gen, &record)) {
+        if (record.op == 'a') {
+            bench_allocate(sys, result, record.process_id, record.size);
+        } else {
+            bench_free(sys, result, record.process_id);
+        }
+    }
+    workload_destroy(&gen);
+}
+
+// Steady-state churn: uniform sizes with exponential lifetimes, capped at 70% occupancy
+void bench_churn(SystemMemory *sys, BenchResult *result) {
+    WorkloadConfig workload = {1000000, 1, {DIST_UNIFORM, 1, 1000, 0, NULL, NULL, 0},
+                               {DIST_EXPONENTIAL, 2000, 0, 0, NULL, NULL, 0}, 0.7};
+    bench_workload(sys, result, &workload);
+}
+
+// Fill then drain: allocate random sizes until a request has to wait, then free every
+// process in random order, for BENCH_ROUNDS rounds
+void bench_fill_drain(SystemMemory *sys, BenchResult *result) {
+    WorkloadGenerator gen = {0};
+    Distribution sizes = {DIST_UNIFORM, 16, 512, 0, NULL, NULL, 0};
+    gen.state = 2;
+    int *live = NULL;
+    int live_capacity = 0;
+    int process_id = 1;
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        int count = 0;
+        while (ensure_capacity((void **)&live, &live_capacity, count + 1, sizeof(int)) == 0) {
+            int size = sample_distribution(&gen, &sizes);
+            if (bench_allocate(sys, result, process_id, size) == -1) {
+                bench_free(sys, result, process_id++);  // Withdraw the waiting request
+                break;
+            }
+            live[count++] = process_id++;
+        }
+
+        // Fisher-Yates shuffle of the free order
+        for (int i = count - 1; i > 0; i--) {
+            int j = (int)(workload_random(&gen) % (unsigned long long)(i + 1));
+            int swap = live[i];
+            live[i] = live[j];
+            live[j] = swap;
+        }
+        for (int i = 0; i < count; i++) {
+            bench_free(sys, result, live[i]);
+        }
+    }
+    free(live);
+}
+
+// Adversarial fragmentation: fill with small blocks, free every other one, then ask for
+// blocks slightly too large for the holes, so every search has to pass all of them
+void bench_fragmentation(SystemMemory *sys, BenchResult *result) {
+    const int small = 4000;
+    int process_id = 1;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        int first = process_id;
+        for (int i = 0; i < small; i++) {
+            bench_allocate(sys, result, process_id++, 16);
+        }
+        for (int i = 0; i < small; i += 2) {
+            bench_free(sys, result, first + i);
+        }
+        int large = process_id;
+        for (int i = 0; i < small / 2; i++) {
+            bench_allocate(sys, result, process_id++, 24);
+        }
+
+        // Release the rest of the round
+        for (int i = 1; i < small; i += 2) {
+            bench_free(sys, result, first + i);
+        }
+        for (int i = 0; i < small / 2; i++) {
+            bench_free(sys, result, large + i);
+        }
+    }
+}
+
+// Wait-queue saturation: processes live far longer than memory allows, so most requests
+// wait and many are withdrawn before they are served
+void bench_saturation(SystemMemory *sys, BenchResult *result) {
+    WorkloadConfig workload = {200000, 3, {DIST_UNIFORM, 1, 2000, 0, NULL, NULL, 0},
+                               {DIST_EXPONENTIAL, 20000, 0, 0, NULL, NULL, 0}, 0};
+    bench_workload(sys, result, &workload);
+}
+
+// Bursts of frees under a backed-up wait queue: memory is overcommitted so waiters always
+// exist, then each round allocates a burst of processes and frees as many random ones.
+// `batched` hands each burst of frees to free_memory_batch(), so the queue drains once.
+void bench_bursts_as(SystemMemory *sys, BenchResult *result, int batched) {
+    const int burst = 512;
+    WorkloadGenerator gen = {0};
+    Distribution sizes = {DIST_UNIFORM, 16, 4096, 0, NULL, NULL, 0};
+    gen.state = 4;
+    int *live = NULL;
+    int live_capacity = 0, count = 0;
+    int process_id = 1;
+    int victims[512];
+
+    // Fill memory until a burst's worth of requests is waiting
+    while (sys->wait_queue_count < burst &&
+           ensure_capacity((void **)&live, &live_capacity, count + 1, sizeof(int)) == 0) {
+        bench_allocate(sys, result, process_id, sample_distribution(&gen, &sizes));
+        live[count++] = process_id++;
+    }
+
+    for (int round = 0; round < BENCH_ROUNDS * 10; round++) {
+        for (int i = 0; i < burst && ensure_capacity((void **)&live, &live_capacity, count + 1,
+                                                     sizeof(int)) == 0; i++) {
+            bench_allocate(sys, result, process_id, sample_distribution(&gen, &sizes));
+            live[count++] = process_id++;
+        }
+
+        // Free random processes, active or still waiting, swap-removing them from the list
+        for (int i = 0; i < burst; i++) {
+            int j = (int)(workload_random(&gen) % (unsigned long long)count);
+            victims[i] = live[j];
+            live[j] = live[--count];
+        }
+        if (batched) {
+            double start = monotonic_ns();
+            free_memory_batch(sys, victims, burst);
+            result->free_ns += monotonic_ns() - start;
+            result->free_ops += burst;
+        } else {
+            for (int i = 0; i < burst; i++) {
+                bench_free(sys, result, victims[i]);
+            }
+        }
+    }
+    free(live);
+}
+
+// Bursts of frees, each free draining the wait queue
+void bench_bursts(SystemMemory *sys, BenchResult *result) {
+    bench_bursts_as(sys, result, 0);
+}
+
+// Bursts of frees, each burst draining the wait queue once
+void bench_bursts_batched(SystemMemory *sys, BenchResult *result) {
+    bench_bursts_as(sys, result, 1);
+}
+
+const BenchScenario BENCH_SCENARIOS[] = {
+    {"churn", bench_churn},
+    {"fill-drain", bench_fill_drain},
+    {"fragmentation", bench_fragmentation},
+    {"saturation", bench_saturation},
+    {"bursts", bench_bursts},
+    {"bursts-batched", bench_bursts_batched},
+};
+
+// Name of an engine in the benchmark results
+const char *engine_name(const PlacementStrategy *strategy) {
+    if (strategy == &FIRST_FIT_LINEAR) {
+        return "first-fit-linear";
+    }
+    if (strategy == &FIRST_FIT_SIMD) {
+        return "first-fit-simd";
+    }
+    return strategy == &FIRST_FIT_INDEXED ? "first-fit-tree" : strategy->name;
+}
+
+// Run one scenario against one engine in a child process, so each run has its own peak RSS
+// Returns 0 on success, -1 if the run failed
+int run_bench_case(const BenchScenario *scenario, const PlacementStrategy *strategy, BenchResult *result) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return -1;
+    }
+    pid_t child = fork();
+    if (child < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+
+    if (child == 0) {
+        close(fds[0]);
+        kb_t block_sizes[] = {BENCH_BLOCK_SIZE, BENCH_BLOCK_SIZE, BENCH_BLOCK_SIZE, BENCH_BLOCK_SIZE};
+        MemoryConfig config = {DEFAULT_CAPACITY, strategy, COALESCE_IMMEDIATE, NULL, 0,
+                               WAIT_FIFO, DEFAULT_MAX_BYPASS, 0};
+        SystemMemory sys;
+        BenchResult run = {0};
+        if (initialize_memory(&sys, 4, block_sizes, &config) != 0) {
+            _exit(1);
+        }
+        scenario->run(&sys, &run);
+
+        kb_t allocated = sys.total_memory - get_total_free_memory(&sys);
+        run.final_fragmentation = external_fragmentation(&sys);
+        run.internal_fragmentation = allocated > 0 ? (double)sys.internal_fragmentation / allocated : 0.0;
+        run.peak_blocks = sys.peak_blocks;
+        run.waiting = sys.wait_queue_count;
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        run.peak_rss_kb = usage.ru_maxrss;
+        long metadata_bytes, peak_used;
+        metadata_footprint(&sys, &metadata_bytes, &peak_used);
+        run.metadata_kb = (metadata_bytes + 1023) / 1024;
+        ssize_t written = write(fds[1], &run, sizeof(run));
+        _exit(written == (ssize_t)sizeof(run) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    ssize_t got = read(fds[0], result, sizeof(BenchResult));
+    close(fds[0]);
+    int status;
+    waitpid(child, &status, 0);
+    return got == (ssize_t)sizeof(BenchResult) && WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+// Run every benchmark scenario against every engine and write DIR/bench.csv and DIR/bench.json
+int run_bench(const char *dir) {
+    const PlacementStrategy *engines[] = {&FIRST_FIT_LINEAR, &FIRST_FIT_INDEXED, &FIRST_FIT_SIMD, &NEXT_FIT,
+                                          &BEST_FIT, &WORST_FIT, &SEGREGATED_FIT, &BUDDY};
+    char csv_path[PATH_MAX];
+    char json_path[PATH_MAX];
+    snprintf(csv_path, sizeof(csv_path), "%s/bench.csv", dir);
+    snprintf(json_path, sizeof(json_path), "%s/bench.json", dir);
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        perror(dir);
+        return 1;
+    }
+    FILE *csv = fopen(csv_path, "w");
+    FILE *json = fopen(json_path, "w");
+    if (csv == NULL || json == NULL) {
+        perror(csv == NULL ? csv_path : json_path);
+        if (csv != NULL) {
+            fclose(csv);
+        }
+        if (json != NULL) {
+            fclose(json);
+        }
+        return 1;
+    }
+
+    fprintf(csv, "scenario,engine,alloc_ops,alloc_ns_per_op,free_ops,free_ns_per_op,peak_rss_kb,metadata_kb,"
+                 "mean_external_fragmentation,final_external_fragmentation,internal_fragmentation,"
+                 "peak_blocks,waiting\n");
+    fprintf(json, "[\n");
+    int result = 0;
+    int rows = 0;
+    for (size_t s = 0; s < sizeof(BENCH_SCENARIOS) / sizeof(BENCH_SCENARIOS[0]); s++) {
+        for (size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); e++) {
+            const char *scenario = BENCH_SCENARIOS[s].name;
+            const char *engine = engine_name(engines[e]);
+            BenchResult r;
+            if (run_bench_case(&BENCH_SCENARIOS[s], engines[e], &r) != 0) {
+                fprintf(stderr, "Benchmark %s/%s failed\n", scenario, engine);
+                result = 1;
+                continue;
+            }
+
+            double alloc_ns = r.alloc_ops > 0 ? r.alloc_ns / r.alloc_ops : 0.0;
+            double free_ns = r.free_ops > 0 ? r.free_ns / r.free_ops : 0.0;
+            double mean_frag = r.frag_samples > 0 ? r.frag_sum / r.frag_samples : r.final_fragmentation;
+            fprintf(csv, "%s,%s,%ld,%.1f,%ld,%.1f,%ld,%ld,%.4f,%.4f,%.4f,%d,%d\n",
+                    scenario, engine, r.alloc_ops, alloc_ns, r.free_ops, free_ns, r.peak_rss_kb, r.metadata_kb,
+                    mean_frag, r.final_fragmentation, r.internal_fragmentation, r.peak_blocks, r.waiting);
+            fprintf(json, "%s  {\"scenario\": \"%s\", \"engine\": \"%s\", \"alloc_ops\": %ld, "
+                          "\"alloc_ns_per_op\": %.1f, \"free_ops\": %ld, \"free_ns_per_op\": %.1f, "
+                          "\"peak_rss_kb\": %ld, \"metadata_kb\": %ld, \"mean_external_fragmentation\": %.4f, "
+                          "\"final_external_fragmentation\": %.4f, \"internal_fragmentation\": %.4f, "
+                          "\"peak_blocks\": %d, \"waiting\": %d}",
+                    rows++ > 0 ? ",\n" : "", scenario, engine, r.alloc_ops, alloc_ns, r.free_ops, free_ns,
+                    r.peak_rss_kb, r.metadata_kb, mean_frag, r.final_fragmentation, r.internal_fragmentation,
+                    r.peak_blocks, r.waiting);
+            printf("%-14s %-17s alloc %8.1f ns/op  free %8.1f ns/op  rss %7ldKB  meta %6ldKB  frag %5.1f%%\n",
+                   scenario, engine, alloc_ns, free_ns, r.peak_rss_kb, r.metadata_kb, 100.0 * mean_frag);
+            fflush(stdout);
+        }
+    }
+    fprintf(json, "\n]\n");
+    if (fclose(csv) != 0 || fclose(json) != 0) {
+        result = 1;
+    }
+    printf("Results written to %s and %s\n", csv_path, json_path);
+    return result;
+}
+
+// Print command-line usage
+void print_usage(const char *program) {
+    printf("Usage: %s [--capacity N] [--strategy NAME] [--index MODE] [--coalesce POLICY]\n"
+           "       [--size-classes LIST] [--wait-policy POLICY] [--max-bypass N] [--compact MODE]\n"
+           "       [--trace FILE --blocks SIZES] [--convert TEXT BINARY]\n"
+           "       [--generate N --blocks SIZES [--seed S] [--size-dist D] [--lifetime-dist D]\n"
+           "        [--occupancy F] [--emit FILE]] [--metrics FILE [--metrics-format F]\n"
+           "       [--sample-every N]] [--restore SNAPSHOT] [--save-snapshot FILE] [--batch N]\n"
+           "       [--sweep FILE [--threads N]] [--concurrent N] [--bench DIR]\n"
+           "       [--check N [--check-repro FILE]] [--telemetry OUT [--telemetry-format F]\n"
+           "       [--telemetry-interval MS]]\n",
+           program);
+    printf("  (no options)      Run the interactive menu-driven simulator\n");
+    printf("  --trace FILE      Replay alloc/free events from a text or binary FILE ('-' for stdin)\n");
+    printf("  --blocks SIZES    Comma separated initial block sizes in KB for batch mode\n");
+    printf("  --convert IN OUT  Convert text trace IN ('-' for stdin) to binary trace OUT\n");
+    printf("  --generate N      Replay N events of a seeded synthetic workload instead of a trace\n");
+    printf("  --seed S          Seed of the generated workload (default 1)\n");
+    printf("  --size-dist D     Request sizes in KB (default uniform:1:1000); D is uniform:MIN:MAX,\n");
+    printf("                    exp:MEAN, lognormal:MU:SIGMA, bimodal:A:B:P or histogram:FILE\n");
+    printf("  --lifetime-dist D Events from allocation to free (default exp:1000)\n");
+    printf("  --occupancy F     Free early to keep live memory near F of total memory (0: off)\n");
+    printf("  --emit FILE       Write the generated workload as a text trace ('-' for stdout)\n");
+    printf("  --metrics FILE    Record a metrics time series of the batch run ('-' for stdout)\n");
+    printf("  --metrics-format F  'csv' lines (default) or 'binary' MetricsSample records\n");
+    printf("  --sample-every N  Events between metric samples (default 1000)\n");
+    printf("  --restore FILE    Start the batch run from a saved snapshot instead of --blocks;\n");
+    printf("                    strategy and policies come from the snapshot\n");
+    printf("  --save-snapshot FILE  Save the whole memory system at the end of the batch run\n");
+    printf("  --batch N         Group replayed events N at a time and serve waiters once per group\n");
+    printf("                    (default 0: after every free)\n");
+    printf("  --sweep FILE      Replay the trace under every configuration listed in FILE, one\n");
+    printf("                    line of KEY=VALUE options per job, on a thread pool\n");
+    printf("  --threads N       Sweep worker threads (default: one per online CPU)\n");
+    printf("  --concurrent N    Replay the generated workload on 1, 2, 4, ... N threads sharing\n");
+    printf("                    one locked heap behind per-thread caches, and report scaling\n");
+    printf("  --check N         Replay the trace or workload through the first-fit engine and\n");
+    printf("                    the reference linear scan in lockstep, comparing their state\n");
+    printf("                    every N events, and stop at the first divergence\n");
+    printf("  --check-repro FILE  Where --check writes the trace up to the divergence\n");
+    printf("                    (default divergence.txt)\n");
+    printf("  --telemetry OUT   Report live counters of the batch run or sweep in the background to\n");
+    printf("                    file OUT, or to a Unix socket with 'unix:PATH'\n");
+    printf("  --telemetry-format F  'prom' Prometheus text (default) or 'json' lines\n");
+    printf("  --telemetry-interval MS  Milliseconds between telemetry reports (default %d)\n",
+           TELEMETRY_INTERVAL_MS);
+    printf("  --bench DIR       Run the benchmark suite against every engine; results go to\n");
+    printf("                    DIR/bench.csv and DIR/bench.json\n");
+    printf("  --capacity N      Initial length of the block, process and wait queue tables\n");
+    printf("                    (default %d; tables grow automatically)\n", DEFAULT_CAPACITY);
+    printf("  --strategy NAME   Placement: first-fit (default), next-fit, best-fit, worst-fit\n");
+    printf("                    segregated (size-class bins) or buddy (binary buddy system)\n");
+    printf("  --size-classes L  Comma separated size-class bounds for segregated fit\n");
+    printf("                    (default: powers of two)\n");
+    printf("  --index MODE      First-fit lookup: 'linear' scan (default), O(log n) 'tree', or\n");
+    printf("                    'simd' vector scan of an address-ordered free-size array\n");
+    printf("  --coalesce POLICY Merge free neighbours 'immediate'ly on free (default),\n");
+    printf("                    'deferred' until an allocation finds no fit, or 'never'\n");
+    printf("  --wait-policy P   Waiter served on free: 'fifo' head only (default), oldest that\n");
+    printf("                    fits ('first-fit'), 'smallest' request, or 'bypass' (FIFO that\n");
+    printf("                    lets fitting waiters pass the head up to --max-bypass times)\n");
+    printf("  --max-bypass N    Times the oldest waiter may be passed (default %d)\n", DEFAULT_MAX_BYPASS);
+    printf("  --compact MODE    Compact memory only on request ('manual', default) or also\n");
+    printf("                    'on-stall' when the total free space fits the oldest waiter\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *trace_path = NULL;
+    const char *block_list = NULL;
+    const char *emit_path = NULL;
+    MetricsOptions metrics = {NULL, 0, 1000};
+    SnapshotOptions snapshot = {NULL, NULL};
+    TelemetryOptions telemetry = {NULL, 0, TELEMETRY_INTERVAL_MS};
+    long batch = 0;
+    long check_interval = 0;
+    const char *check_repro = "divergence.txt";
+    const char *sweep_path = NULL;
+    int concurrent_threads = 0;
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = online > 0 ? (int)online : 1;
+    WorkloadConfig workload = {0, 1, {DIST_UNIFORM, 1, 1000, 0, NULL, NULL, 0},
+                               {DIST_EXPONENTIAL, 1000, 0, 0, NULL, NULL, 0}, 0};
+    const char *strategy_name = "first-fit";
+    int use_index = INDEX_LINEAR;
+    kb_t *size_classes = NULL;
+    MemoryConfig config = {DEFAULT_CAPACITY, NULL, COALESCE_IMMEDIATE, NULL, 0, WAIT_FIFO, DEFAULT_MAX_BYPASS, 0};
+
+    // Parse command-line options for batch mode
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (strcmp(argv[i], "--convert") == 0 && i + 2 < argc) {
+            free(size_classes);
+            return convert_trace(argv[i + 1], argv[i + 2]);
+        } else if (strcmp(argv[i], "--blocks") == 0 && i + 1 < argc) {
+            block_list = argv[++i];
+        } else if (strcmp(argv[i], "--capacity") == 0 && i + 1 < argc) {
+            config.capacity = atoi(argv[++i]);
+            if (config.capacity < 1) {
+                fprintf(stderr, "--capacity must be a positive integer\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--index") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "tree") == 0) {
+                use_index = INDEX_TREE;
+            } else if (strcmp(argv[i], "simd") == 0) {
+                use_index = INDEX_SIMD;
+            } else if (strcmp(argv[i], "linear") == 0) {
+                use_index = INDEX_LINEAR;
+            } else {
+                fprintf(stderr, "Unknown index '%s' (expected linear, tree or simd)\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--strategy") == 0 && i + 1 < argc) {
+            strategy_name = argv[++i];
+        } else if (strcmp(argv[i], "--size-classes") == 0 && i + 1 < argc) {
+            free(size_classes);
+            config.num_size_classes = parse_size_classes(argv[++i], &size_classes);
+            if (config.num_size_classes < 0) {
+                fprintf(stderr, "--size-classes expects 1 to %d strictly increasing sizes such as 16,64,256\n",
+                        MAX_SIZE_CLASSES - 1);
+                return 1;
+            }
+            config.size_classes = size_classes;
+        } else if (strcmp(argv[i], "--coalesce") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "immediate") == 0) {
+                config.coalesce = COALESCE_IMMEDIATE;
+            } else if (strcmp(argv[i], "deferred") == 0) {
+                config.coalesce = COALESCE_DEFERRED;
+            } else if (strcmp(argv[i], "never") == 0) {
+                config.coalesce = COALESCE_NEVER;
+            } else {
+                fprintf(stderr, "Unknown coalescing policy '%s' (expected immediate, deferred or never)\n",
+                        argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--wait-policy") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "fifo") == 0) {
+                config.wait_policy = WAIT_FIFO;
+            } else if (strcmp(argv[i], "first-fit") == 0) {
+                config.wait_policy = WAIT_FIRST_FIT;
+            } else if (strcmp(argv[i], "smallest") == 0) {
+                config.wait_policy = WAIT_SMALLEST;
+            } else if (strcmp(argv[i], "bypass") == 0) {
+                config.wait_policy = WAIT_BYPASS;
+            } else {
+                fprintf(stderr, "Unknown wait policy '%s' (expected fifo, first-fit, smallest or bypass)\n",
+                        argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--max-bypass") == 0 && i + 1 < argc) {
+            long max_bypass;
+            if (parse_count(argv[++i], INT_MAX, &max_bypass) != 0) {
+                fprintf(stderr, "--max-bypass must be a non-negative integer\n");
+                return 1;
+            }
+            config.max_bypass = (int)max_bypass;
+        } else if (strcmp(argv[i], "--compact") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "on-stall") == 0) {
+                config.compact_on_stall = 1;
+            } else if (strcmp(argv[i], "manual") == 0) {
+                config.compact_on_stall = 0;
+            } else {
+                fprintf(stderr, "Unknown compaction mode '%s' (expected manual or on-stall)\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--generate") == 0 && i + 1 < argc) {
+            workload.events = atol(argv[++i]);
+            if (workload.events < 1) {
+                fprintf(stderr, "--generate must be a positive number of events\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            workload.seed = strtoull(argv[++i], NULL, 10);
+        } else if ((strcmp(argv[i], "--size-dist") == 0 || strcmp(argv[i], "--lifetime-dist") == 0) &&
+                   i + 1 < argc) {
+            Distribution *dist = strcmp(argv[i], "--size-dist") == 0 ? &workload.sizes : &workload.lifetimes;
+            destroy_distribution(dist);
+            if (parse_distribution(argv[i + 1], dist) != 0) {
+                fprintf(stderr, "Invalid distribution '%s' for %s (expected uniform:MIN:MAX, exp:MEAN, "
+                        "lognormal:MU:SIGMA, bimodal:A:B:P or histogram:FILE)\n", argv[i + 1], argv[i]);
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--occupancy") == 0 && i + 1 < argc) {
+            workload.occupancy = atof(argv[++i]);
+            if (workload.occupancy < 0 || workload.occupancy > 1) {
+                fprintf(stderr, "--occupancy must be between 0 and 1\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--emit") == 0 && i + 1 < argc) {
+            emit_path = argv[++i];
+        } else if (strcmp(argv[i], "--metrics") == 0 && i + 1 < argc) {
+            metrics.path = argv[++i];
+        } else if (strcmp(argv[i], "--metrics-format") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "csv") == 0 || strcmp(argv[i], "binary") == 0) {
+                metrics.binary = argv[i][0] == 'b';
+            } else {
+                fprintf(stderr, "Unknown metrics format '%s' (expected csv or binary)\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--sample-every") == 0 && i + 1 < argc) {
+            metrics.interval = atol(argv[++i]);
+            if (metrics.interval < 1) {
+                fprintf(stderr, "--sample-every must be a positive number of events\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--restore") == 0 && i + 1 < argc) {
+            snapshot.restore_path = argv[++i];
+        } else if (strcmp(argv[i], "--save-snapshot") == 0 && i + 1 < argc) {
+            snapshot.save_path = argv[++i];
+        } else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+            if (parse_count(argv[++i], LONG_MAX, &batch) != 0) {
+                fprintf(stderr, "--batch must be a non-negative number of events\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--check") == 0 && i + 1 < argc) {
+            check_interval = atol(argv[++i]);
+            if (check_interval < 1) {
+                fprintf(stderr, "--check must be a positive number of events\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--check-repro") == 0 && i + 1 < argc) {
+            check_repro = argv[++i];
+        } else if (strcmp(argv[i], "--telemetry") == 0 && i + 1 < argc) {
+            telemetry.path = argv[++i];
+        } else if (strcmp(argv[i], "--telemetry-format") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "prom") == 0 || strcmp(argv[i], "json") == 0) {
+                telemetry.json = argv[i][0] == 'j';
+            } else {
+                fprintf(stderr, "Unknown telemetry format '%s' (expected prom or json)\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--telemetry-interval") == 0 && i + 1 < argc) {
+            telemetry.interval_ms = atol(argv[++i]);
+            if (telemetry.interval_ms < 1) {
+                fprintf(stderr, "--telemetry-interval must be a positive number of milliseconds\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--sweep") == 0 && i + 1 < argc) {
+            sweep_path = argv[++i];
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+            if (threads < 1) {
+                fprintf(stderr, "--threads must be a positive integer\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--concurrent") == 0 && i + 1 < argc) {
+            concurrent_threads = atoi(argv[++i]);
+            if (concurrent_threads < 1 || concurrent_threads > MAX_CONCURRENT_THREADS) {
+                fprintf(stderr, "--concurrent must be between 1 and %d threads\n", MAX_CONCURRENT_THREADS);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+            free(size_classes);
+            return run_bench(argv[i + 1]);
+        } else if (strcmp(argv[i], "--help") == 0) {
+            print_usage(argv[0]);
+            return 0;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    config.strategy = find_strategy(strategy_name, use_index);
+    if (config.strategy == NULL) {
+        fprintf(stderr, "Unknown strategy '%s' (expected first-fit, next-fit, best-fit, worst-fit, "
+                "segregated or buddy)\n", strategy_name);
+        free(size_classes);
+        return 1;
+    }
+
+    if (concurrent_threads > 0) {
+        int result = 1;
+        if (block_list == NULL || workload.events == 0) {
+            fprintf(stderr, "--concurrent requires --generate and --blocks\n");
+        } else {
+            result = run_concurrent(concurrent_threads, &workload, block_list, &config);
+        }
+        destroy_distribution(&workload.sizes);
+        destroy_distribution(&workload.lifetimes);
+        free(size_classes);
+        return result;
+    }
+
+    if (check_interval > 0) {
+        int result = 1;
+        if (block_list == NULL || (trace_path == NULL && workload.events == 0)) {
+            fprintf(stderr, "--check requires --blocks and --trace or --generate\n");
+        } else if (strcmp(config.strategy->name, "first-fit") != 0) {
+            fprintf(stderr, "--check compares first-fit engines with the linear scan (use --strategy first-fit)\n");
+        } else if (trace_path != NULL && strcmp(trace_path, "-") == 0) {
+            fprintf(stderr, "--check needs a trace file, not stdin\n");
+        } else {
+            result = run_check(trace_path, &workload, block_list, &config, batch, check_interval, check_repro);
+        }
+        destroy_distribution(&workload.sizes);
+        destroy_distribution(&workload.lifetimes);
+        free(size_classes);
+        return result;
+    }
+
+    if (sweep_path != NULL) {
+        int result = run_sweep(sweep_path, threads, trace_path, workload.events > 0 ? &workload : NULL,
+                               block_list, &config, strategy_name, use_index, batch,
+                               telemetry.path != NULL ? &telemetry : NULL);
+        destroy_distribution(&workload.sizes);
+        destroy_distribution(&workload.lifetimes);
+        free(size_classes);
+        return result;
+    }
+
+    if (trace_path != NULL || workload.events > 0) {
+        int result = 1;
+        if (workload.events > 0 && emit_path != NULL) {
+            if (block_list == NULL) {
+                fprintf(stderr, "--emit requires --blocks\n");
+            } else {
+                result = emit_workload(&workload, block_list, emit_path);
+            }
+        } else if (block_list == NULL && snapshot.restore_path == NULL) {
+            fprintf(stderr, "Batch mode requires --blocks or --restore\n");
+        } else {
+            result = run_batch(trace_path, workload.events > 0 ? &workload : NULL, block_list, &config,
+                               metrics.path != NULL ? &metrics : NULL, &snapshot, batch,
+                               telemetry.path != NULL ? &telemetry : NULL);
+        }
+        destroy_distribution(&workload.sizes);
+        destroy_distribution(&workload.lifetimes);
+        free(size_classes);
+        return result;
+    }
+
+    SystemMemory system_memory;
+
+    printf("System Capacity:\n");
+    printf("- Initial table capacity: %d blocks, processes and waiting entries\n", config.capacity);
+    printf("- Tables grow automatically when they fill up\n");
+    printf("---------------------------------------------\n");
+
+    // Get number of memory blocks from user
+    int num_blocks = (int)get_valid_integer("Enter the number of memory blocks you want to simulate: ", 1, INT_MAX);
+
+    // Get sizes for each memory block
+    kb_t *block_sizes = malloc((size_t)num_blocks * sizeof(kb_t));
+    if (block_sizes == NULL) {
+        fprintf(stderr, "Could not allocate %d block sizes\n", num_blocks);
+        return 1;
+    }
+    for (int i = 0; i < num_blocks; i++) {
+        char prompt[50];
+        snprintf(prompt, sizeof(prompt), "Enter size of memory block %d (in KB): ", i + 1);
+        block_sizes[i] = (kb_t)get_valid_integer(prompt, 1, KB_MAX);
+    }
+
+    // Initialize memory system
+    int init_result = initialize_memory(&system_memory, num_blocks, block_sizes, &config);
+    free(block_sizes);
+    free(size_classes);
+    if (init_result != 0) {
+        fprintf(stderr, "Could not allocate simulator tables\n");
+        return 1;
+    }
+    system_memory.verbose = 1;
+
+    // Variables for process management
+    int choice, free_id, process_id = 1;
+    kb_t size;
+    long duration;
+    OutputBuffer layout = {NULL, 0, 0};
+
+    // Main program loop
+    while (1) {
+        printf("\n----First Fit Memory Allocation Simulator----\n\n");
+        print_memory_layout(&system_memory, &layout);  // Display a summary of the memory state
+        display_menu();  // Show menu options
+        choice = (int)get_valid_integer("", 1, 5);
+
+        // Handle user choices
+        switch (choice) {
+            case 1:  // Allocate Memory
+                size = (kb_t)get_valid_integer("Enter memory size to allocate (in KB): ", 1, KB_MAX);
+                duration = get_valid_integer("Enter how many steps the process runs (0 until freed): ", 0,
+                                             INT_MAX);
+                set_clock(&system_memory, system_memory.clock + 1);
+
+                // Attempt to allocate memory
+                kb_t address = allocate_for(&system_memory, process_id++, size, duration);
+                if (address != -1) {
+                    printf("Memory allocated at address %" PRIkb "\n", address);
+                } else {
+                    printf("Process added to wait queue\n");
+                }
+                break;
+
+            case 2:  // Free Memory
+                free_id = (int)get_valid_integer("Enter process number (ID) to free memory: ", 1, process_id - 1);
+                set_clock(&system_memory, system_memory.clock + 1);
+                free_memory(&system_memory, free_id);
+                break;
+
+            case 3:  // Compact Memory
+                set_clock(&system_memory, system_memory.clock + 1);
+                compact_memory(&system_memory);
+                drain_wait_queue(&system_memory);
+                break;
+
+            case 4:  // Show Full Layout
+                print_full_layout(&system_memory, &layout);
                 break;
 
-            case 3:  // Exit Program
+            case 5:  // Exit Program
                 printf("Exiting...\n");
+#ifdef FF_STATS
+                print_hot_path_stats(&system_memory);
+#endif
+                free(layout.data);
+                destroy_memory(&system_memory);
                 exit(0);
 
             default: